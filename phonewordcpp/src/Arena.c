@@ -0,0 +1,126 @@
+#include <stdlib.h>
+#include <string.h>
+#include "Arena.h"
+
+/* Alignment of every allocation, enough for any basic type. */
+#define ARENA_ALIGN 16
+
+#define ARENA_ROUND(n) (((n) + ARENA_ALIGN - 1) & ~(size_t)(ARENA_ALIGN - 1))
+
+/* Data starts this far into a block, so it is aligned like malloc()'s. */
+#define ARENA_HEADER ARENA_ROUND(sizeof(ArenaBlock))
+
+void arena_init( Arena* arena, size_t block_size )
+{
+	memset(arena, 0, sizeof(*arena));
+	arena->block_size = block_size;
+}
+
+/*
+ * Allocate a block for at least size bytes and link it after the current
+ * one.
+ */
+static ArenaBlock*
+arena_new_block( Arena* arena, size_t size )
+{
+	ArenaBlock* block;
+
+	block = (ArenaBlock*)malloc(ARENA_HEADER + size);
+	if ( 0 == block ) {
+		return 0;
+	}
+	block->size = size;
+	block->used = 0;
+	if ( arena->current ) {
+		block->next = arena->current->next;
+		arena->current->next = block;
+	} else {
+		block->next = arena->blocks;
+		arena->blocks = block;
+	}
+	arena->current = block;
+	arena->reserved += size;
+	return block;
+}
+
+#ifdef ARENA_USE_MALLOC
+
+void* arena_alloc( Arena* arena, size_t size )
+{
+	ArenaBlock* block = arena_new_block(arena, size);
+	if ( 0 == block ) {
+		return 0;
+	}
+	arena->allocated += size;
+	return (char*)block + ARENA_HEADER;
+}
+
+void arena_reset( Arena* arena )
+{
+	arena_free(arena);
+}
+
+#else
+
+void* arena_alloc( Arena* arena, size_t size )
+{
+	ArenaBlock* block = arena->current;
+	void* p;
+
+	size = ARENA_ROUND(size);
+
+	/* Go on to the next kept block, or a new one, if this one is full. */
+	while ( 0 == block || block->used + size > block->size ) {
+		if ( block && block->next ) {
+			block = block->next;
+			block->used = 0;
+			arena->current = block;
+		} else {
+			block = arena_new_block(arena, size > arena->block_size ? 
+				size : arena->block_size);
+			if ( 0 == block ) {
+				return 0;
+			}
+		}
+	}
+
+	p = (char*)block + ARENA_HEADER + block->used;
+	block->used += size;
+	arena->allocated += size;
+	return p;
+}
+
+void arena_reset( Arena* arena )
+{
+	arena->current = arena->blocks;
+	if ( arena->current ) {
+		arena->current->used = 0;
+	}
+	arena->allocated = 0;
+}
+
+#endif
+
+void* arena_calloc( Arena* arena, size_t size )
+{
+	void* p = arena_alloc(arena, size);
+	if ( p ) {
+		memset(p, 0, size);
+	}
+	return p;
+}
+
+void arena_free( Arena* arena )
+{
+	ArenaBlock* block = arena->blocks;
+
+	while ( block ) {
+		ArenaBlock* next = block->next;
+		free(block);
+		block = next;
+	}
+	arena->blocks = 0;
+	arena->current = 0;
+	arena->allocated = 0;
+	arena->reserved = 0;
+}
@@ -0,0 +1,67 @@
+#ifndef ARENA_H
+#define ARENA_H
+
+#include <stddef.h>
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+/* Arena Allocator
+ *
+ * Hands out memory by bumping a pointer through large blocks. Nothing is
+ * freed on its own: arena_reset() makes all of the memory available again
+ * at once (keeping the blocks for reuse) and arena_free() releases the 
+ * blocks.
+ *
+ * Compiled with ARENA_USE_MALLOC every allocation is a separate malloc(),
+ * released by arena_reset(), so tools like ASan and valgrind can check
+ * each one.
+ */
+
+typedef struct _ArenaBlock {
+	struct _ArenaBlock* next;
+	size_t size;         /* bytes of data following the header */
+	size_t used;
+} ArenaBlock;
+
+typedef struct _Arena {
+	ArenaBlock* blocks;  /* every block, in the order they are used */
+	ArenaBlock* current; /* the block allocations come from */
+	size_t block_size;
+	size_t allocated;    /* bytes handed out since the last reset */
+	size_t reserved;     /* bytes held in blocks */
+} Arena;
+
+/*
+ * Initialize an empty arena. Blocks of block_size bytes are allocated as 
+ * needed (bigger ones for bigger requests).
+ */
+void arena_init( Arena* arena, size_t block_size );
+
+/*
+ * Allocate size bytes, aligned for any type. The memory is not cleared.
+ * Returns NULL if out of memory.
+ */
+void* arena_alloc( Arena* arena, size_t size );
+
+/*
+ * Same as arena_alloc(), but the memory is cleared.
+ */
+void* arena_calloc( Arena* arena, size_t size );
+
+/*
+ * Forget all allocations. The blocks are kept to be used again.
+ */
+void arena_reset( Arena* arena );
+
+/*
+ * Free all blocks. The arena can be used again afterwards.
+ */
+void arena_free( Arena* arena );
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif
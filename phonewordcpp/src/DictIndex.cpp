@@ -0,0 +1,520 @@
+#include <string.h>
+#include <stdio.h>
+#include <fcntl.h>
+#include <unistd.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <algorithm>
+#include "DictIndex.h"
+
+namespace jz{
+
+static const char INDEX_MAGIC[8] = "PHWDIDX";
+
+DictIndex::DictIndex()
+    : image(NULL), mappedSize(0), header(NULL), slots(NULL), states(NULL), longKeys(NULL),
+      wordOffsets(NULL), keyPool(NULL), wordPool(NULL)
+{}
+
+DictIndex::~DictIndex() {
+    close();
+}
+
+bool DictIndex::open(const char *filename) {
+    close();
+    int fd = ::open(filename, O_RDONLY);
+    if( fd < 0 ) return false;
+    struct stat st;
+    if( fstat(fd, &st) != 0 || st.st_size < (off_t)sizeof(DictIndexHeader) ) {
+        ::close(fd);
+        return false;
+    }
+    void *p = mmap(NULL, st.st_size, PROT_READ, MAP_SHARED, fd, 0);
+    ::close(fd);  // the mapping keeps the file referenced
+    if( p == MAP_FAILED ) return false;
+
+    if( !attach((const char*)p, st.st_size) ) {
+        munmap(p, st.st_size);
+        return false;
+    }
+    mappedSize = st.st_size;
+    return true;
+}
+
+bool DictIndex::assign(std::vector<char>& data) {
+    close();
+    ownedImage.swap(data);
+    if( ownedImage.empty() || !attach(&ownedImage[0], ownedImage.size()) ) {
+        ownedImage.clear();
+        return false;
+    }
+    return true;
+}
+
+void DictIndex::close() {
+    if( image && mappedSize ) {
+        munmap((void*)image, mappedSize);
+    }
+    ownedImage.clear();
+    image = NULL;
+    mappedSize = 0;
+    header = NULL;
+}
+
+// validate the header and set up section pointers
+bool DictIndex::attach(const char *data, size_t size) {
+    const DictIndexHeader *h = (const DictIndexHeader*)data;
+    if( size < sizeof(DictIndexHeader)
+        || memcmp(h->magic, INDEX_MAGIC, sizeof(INDEX_MAGIC)) != 0
+        || h->byteOrder != BYTE_ORDER_MARK
+        || h->version != VERSION
+        || h->imageSize != size ) {
+        return false;
+    }
+    // every section has to lie inside the image
+    if( h->numSlots == 0 || (h->numSlots & (h->numSlots-1)) != 0
+        || h->slotsOffset % sizeof(uint64_t) != 0
+        || h->slotsOffset + (uint64_t)h->numSlots*sizeof(DictIndexSlot) > size
+        || h->numStates == 0 || h->statesOffset % sizeof(uint32_t) != 0
+        || h->statesOffset + (uint64_t)h->numStates*sizeof(DictIndexState) > size
+        || h->longKeysOffset % sizeof(uint32_t) != 0
+        || h->longKeysOffset + (uint64_t)h->numLongKeys*sizeof(DictIndexKey) > size
+        || h->wordOffsetsOffset % sizeof(uint32_t) != 0
+        || h->wordOffsetsOffset + (uint64_t)h->numWords*sizeof(uint32_t) > size
+        || h->keyPoolOffset + (uint64_t)h->keyPoolSize > size
+        || h->wordPoolOffset + (uint64_t)h->wordPoolSize > size ) {
+        return false;
+    }
+    image = data;
+    header = h;
+    slots = (const DictIndexSlot*)(data + h->slotsOffset);
+    states = (const DictIndexState*)(data + h->statesOffset);
+    longKeys = (const DictIndexKey*)(data + h->longKeysOffset);
+    wordOffsets = (const uint32_t*)(data + h->wordOffsetsOffset);
+    keyPool = data + h->keyPoolOffset;
+    wordPool = data + h->wordPoolOffset;
+    if( !validate() ) {
+        image = NULL;
+        header = NULL;
+        return false;
+    }
+    return true;
+}
+
+// One pass over the sections, so that a corrupt or truncated file is
+// refused rather than read out of bounds or looped on by the lookups.
+bool DictIndex::validate() const {
+    const DictIndexHeader& h = *header;
+    // find() probes until it meets an empty slot
+    bool hasEmptySlot = false;
+    for(uint32_t i=0; i<h.numSlots; ++i) {
+        const DictIndexSlot& sl = slots[i];
+        if( sl.key == 0 ) {
+            hasEmptySlot = true;
+        }else if( (uint64_t)sl.firstWord + sl.numWords > h.numWords ) {
+            return false;
+        }
+    }
+    if( !hasEmptySlot ) return false;
+    for(uint32_t i=0; i<h.numLongKeys; ++i) {
+        const DictIndexKey& k = longKeys[i];
+        if( (uint64_t)k.keyOffset + k.keyLength > h.keyPoolSize
+            || (uint64_t)k.firstWord + k.numWords > h.numWords ) {
+            return false;
+        }
+    }
+    // words end inside the pool
+    if( h.numWords > 0 && (h.wordPoolSize == 0 || wordPool[h.wordPoolSize-1] != '\0') ) {
+        return false;
+    }
+    for(uint32_t i=0; i<h.numWords; ++i) {
+        if( wordOffsets[i] >= h.wordPoolSize ) return false;
+    }
+    // Children are one digit deeper than their parent, and the failure and
+    // output links go to shallower states, so follow() and the output
+    // chains of forEachMatch() end, and a match never starts before the
+    // number.
+    if( states[0].depth != 0 ) return false;
+    for(uint32_t s=0; s<h.numStates; ++s) {
+        const DictIndexState& st = states[s];
+        if( (st.childMask & ~0x3ffu) != 0
+            || (uint64_t)st.firstChild + popcount16(st.childMask) > h.numStates
+            || st.fail >= h.numStates || st.output >= h.numStates
+            || (uint64_t)st.firstWord + st.numWords > h.numWords ) {
+            return false;
+        }
+        if( s != 0 && (states[st.fail].depth >= st.depth
+                       || (st.output != 0 && states[st.output].depth >= st.depth)) ) {
+            return false;
+        }
+        for(unsigned c=0; c<popcount16(st.childMask); ++c) {
+            if( states[st.firstChild + c].depth != st.depth + 1 ) return false;
+        }
+    }
+    return true;
+}
+
+DictIndex::Range DictIndex::find(const char *digits, size_t len) const {
+    if( len > MAX_PACKED_DIGITS ) {
+        return findLong(digits, len);
+    }
+    return find(packDigits(digits, len));
+}
+
+DictIndex::Range DictIndex::find(uint64_t packed) const {
+    Range r;
+    if( packed == 0 ) return r;
+    uint32_t mask = header->numSlots - 1;
+    for(uint32_t i=hashPackedDigits(packed, mask); slots[i].key != 0; i=(i+1) & mask) {
+        if( slots[i].key == packed ) {
+            r.first = slots[i].firstWord;
+            r.count = slots[i].numWords;
+            break;
+        }
+    }
+    return r;
+}
+
+// binary search over the sorted long keys
+DictIndex::Range DictIndex::findLong(const char *digits, size_t len) const {
+    Range r;
+    size_t lo = 0, hi = header->numLongKeys;
+    while( lo < hi ) {
+        size_t mid = (lo + hi) / 2;
+        const DictIndexKey& k = longKeys[mid];
+        int c = memcmp(keyPool + k.keyOffset, digits, k.keyLength < len ? k.keyLength : len);
+        if( c == 0 ) {
+            if( k.keyLength == len ) {
+                r.first = k.firstWord;
+                r.count = k.numWords;
+                return r;
+            }
+            c = k.keyLength < len ? -1 : 1;
+        }
+        if( c < 0 )
+            lo = mid + 1;
+        else
+            hi = mid;
+    }
+    return r;
+}
+
+DictIndexBuilder::DictIndexBuilder(int minWordLen): poolSize(0), sorted(true), minWordLen(minWordLen)
+{}
+
+// by digits like std::string, then word, then insertion order
+struct DictIndexBuilder::EntryLess {
+    const char *digits, *words;
+    EntryLess(const char *digits, const char *words): digits(digits), words(words) {}
+    bool operator()(const Entry& a, const Entry& b) const {
+        if( a.length != b.length ) {
+            int c = memcmp(digits + a.offset, digits + b.offset, a.length < b.length ? a.length : b.length);
+            return c != 0 ? c < 0 : a.length < b.length;
+        }
+        int c = memcmp(digits + a.offset, digits + b.offset, a.length);
+        if( c == 0 ) c = memcmp(words + a.offset, words + b.offset, a.length);
+        return c != 0 ? c < 0 : a.offset < b.offset;
+    }
+};
+
+// same key, by insertion order
+struct DictIndexBuilder::EntryOrder {
+    bool operator()(const Entry& a, const Entry& b) const {
+        return a.offset < b.offset;
+    }
+};
+
+void DictIndexBuilder::add(const char *digits, const char *word, size_t len) {
+    char *d, *w;
+    reserve(len + 1, d, w);
+    memcpy(d, digits, len);
+    memcpy(w, word, len);
+    addReserved(0, len);
+    commit(len + 1);
+}
+
+void DictIndexBuilder::grow(size_t size) {
+    const size_t n = std::max(2*digitPool.size(), size);
+    digitPool.resize(n);
+    wordPool.resize(n);
+}
+
+static bool sameKey(const char *digits, uint32_t a, uint32_t b, uint32_t len) {
+    return memcmp(digits + a, digits + b, len) == 0;
+}
+
+void DictIndexBuilder::sort() {
+    if( entries.empty() ) return;
+    const char *w = &wordPool[0];
+    if( !sorted ) {
+        std::sort(entries.begin(), entries.end(), EntryLess(&digitPool[0], w));
+    }
+    // keep the first of equal pairs, which was added first. A word has a
+    // single key, so comparing the words is enough.
+    size_t n = 1;
+    for(size_t i=1; i<entries.size(); ++i) {
+        const Entry& e = entries[i];
+        const Entry& last = entries[n-1];
+        if( e.length == last.length && memcmp(w + e.offset, w + last.offset, e.length) == 0 ) {
+            continue;
+        }
+        entries[n++] = e;
+    }
+    entries.resize(n);
+    sorted = true;
+}
+
+void DictIndexBuilder::merge(DictIndexBuilder& other) {
+    const uint32_t base = poolSize;
+    const size_t mid = entries.size();
+    const bool bothSorted = sorted && other.sorted;
+    digitPool.resize(poolSize);
+    wordPool.resize(poolSize);
+    digitPool.insert(digitPool.end(), other.digitPool.begin(), other.digitPool.begin() + other.poolSize);
+    wordPool.insert(wordPool.end(), other.wordPool.begin(), other.wordPool.begin() + other.poolSize);
+    poolSize += other.poolSize;
+    entries.reserve(entries.size() + other.entries.size());
+    for(size_t i=0; i<other.entries.size(); ++i) {
+        Entry e = other.entries[i];
+        e.offset += base;
+        entries.push_back(e);
+    }
+    std::vector<char>().swap(other.digitPool);
+    std::vector<char>().swap(other.wordPool);
+    std::vector<Entry>().swap(other.entries);
+    other.poolSize = 0;
+    other.sorted = true;
+    if( !bothSorted ) {
+        sorted = false;
+    }else if( mid > 0 && mid < entries.size() ) {
+        std::inplace_merge(entries.begin(), entries.begin() + mid, entries.end(),
+                           EntryLess(&digitPool[0], &wordPool[0]));
+        sort();  // drops the duplicates of the two parts
+    }
+}
+
+static uint32_t align8(uint32_t n) {
+    return (n + 7) & ~7u;
+}
+
+namespace {
+
+// the keys as a plain trie, before it is laid out breadth first
+struct BuildNode {
+    int32_t child[10];
+    uint32_t firstWord, numWords;
+    uint16_t depth;
+    BuildNode(uint16_t depth): firstWord(0), numWords(0), depth(depth) {
+        for(int d=0; d<10; ++d) child[d] = -1;
+    }
+};
+
+// The words grouped by key, keys in order: the words of key k are at
+// offsets[keyFirst[k]..keyFirst[k+1]) of the builder's pools.
+struct KeyGroups {
+    const char *digitPool, *wordPool;
+    std::vector<uint32_t> keyFirst;
+    std::vector<uint32_t> offsets;
+    std::vector<uint32_t> lengths;  // of the words of each key
+
+    size_t numKeys() const {
+        return keyFirst.size() - 1;
+    }
+    const char* digits(size_t k) const {
+        return digitPool + offsets[keyFirst[k]];
+    }
+    uint32_t length(size_t k) const {
+        return lengths[k];
+    }
+    uint32_t numWords(size_t k) const {
+        return keyFirst[k+1] - keyFirst[k];
+    }
+    const char* word(size_t i) const {
+        return wordPool + offsets[i];
+    }
+};
+
+}
+
+static bool isDigits(const char *s, size_t len) {
+    for(size_t i=0; i<len; ++i) {
+        if( (unsigned)(s[i] - '0') > 9 ) return false;
+    }
+    return true;
+}
+
+// Builds the automaton of all keys into states. Keys get their words in
+// key order, like in the other sections.
+static void buildStates(const KeyGroups& keys, std::vector<DictIndexState>& states) {
+    std::vector<BuildNode> nodes;
+    nodes.push_back(BuildNode(0));
+    uint32_t nword = 0;
+    for(size_t k=0; k<keys.numKeys(); ++k) {
+        const uint32_t first = nword;
+        nword += keys.numWords(k);
+        const char *digits = keys.digits(k);
+        if( !isDigits(digits, keys.length(k)) ) {
+            continue;  // can't be found by find() either
+        }
+        int32_t n = 0;
+        for(size_t i=0; i<keys.length(k); ++i) {
+            int d = digits[i] - '0';
+            if( nodes[n].child[d] < 0 ) {
+                nodes[n].child[d] = nodes.size();
+                nodes.push_back(BuildNode(i+1));
+            }
+            n = nodes[n].child[d];
+        }
+        nodes[n].firstWord = first;
+        nodes[n].numWords = keys.numWords(k);
+    }
+
+    // number the nodes breadth first, and link every node to the longest
+    // proper suffix of it that is a node too
+    std::vector<int32_t> order(1, 0), id(nodes.size(), 0), fail(nodes.size(), 0);
+    for(size_t q=0; q<order.size(); ++q) {
+        const int32_t u = order[q];
+        for(int d=0; d<10; ++d) {
+            const int32_t c = nodes[u].child[d];
+            if( c < 0 ) continue;
+            id[c] = order.size();
+            order.push_back(c);
+            if( u != 0 ) {
+                int32_t f = fail[u];
+                while( f != 0 && nodes[f].child[d] < 0 ) {
+                    f = fail[f];
+                }
+                fail[c] = nodes[f].child[d] >= 0 ? nodes[f].child[d] : 0;
+            }
+        }
+    }
+
+    states.assign(nodes.size(), DictIndexState());
+    for(size_t q=0; q<order.size(); ++q) {
+        const int32_t u = order[q];
+        DictIndexState& st = states[q];
+        memset(&st, 0, sizeof(st));
+        for(int d=0; d<10; ++d) {
+            if( nodes[u].child[d] < 0 ) continue;
+            if( st.childMask == 0 ) st.firstChild = id[nodes[u].child[d]];
+            st.childMask |= 1u << d;
+        }
+        st.fail = id[fail[u]];
+        st.firstWord = nodes[u].firstWord;
+        st.numWords = nodes[u].numWords;
+        st.depth = nodes[u].depth;
+        // fail[u] comes before u, so its output is set already
+        const DictIndexState& f = states[st.fail];
+        st.output = u == 0 ? 0 : (f.numWords > 0 ? st.fail : f.output);
+    }
+}
+
+void DictIndexBuilder::build(std::vector<char>& image) {
+    sort();
+    // group by key, and put the words of each key back in insertion order
+    KeyGroups keys;
+    keys.digitPool = entries.empty() ? NULL : &digitPool[0];
+    keys.wordPool = entries.empty() ? NULL : &wordPool[0];
+    keys.offsets.reserve(entries.size());
+    for(size_t i=0; i<entries.size(); ) {
+        size_t j = i + 1;
+        while( j < entries.size() && entries[j].length == entries[i].length
+               && sameKey(keys.digitPool, entries[j].offset, entries[i].offset, entries[i].length) ) {
+            ++j;
+        }
+        std::sort(entries.begin() + i, entries.begin() + j, EntryOrder());
+        keys.keyFirst.push_back(i);
+        keys.lengths.push_back(entries[i].length);
+        for(; i<j; ++i) {
+            keys.offsets.push_back(entries[i].offset);
+        }
+    }
+    keys.keyFirst.push_back(entries.size());
+    sorted = false;  // the words of a key are out of (digits, word) order now
+
+    DictIndexHeader h;
+    memset(&h, 0, sizeof(h));
+    memcpy(h.magic, INDEX_MAGIC, sizeof(INDEX_MAGIC));
+    h.byteOrder = DictIndex::BYTE_ORDER_MARK;
+    h.version = DictIndex::VERSION;
+    h.minWordLen = minWordLen;
+    h.numKeys = keys.numKeys();
+    for(size_t k=0; k<keys.numKeys(); ++k) {
+        if( keys.length(k) > DictIndex::MAX_PACKED_DIGITS ) {
+            h.keyPoolSize += keys.length(k);
+            ++h.numLongKeys;
+        }
+        h.wordPoolSize += keys.numWords(k) * (keys.length(k) + 1);
+        h.numWords += keys.numWords(k);
+    }
+    h.numSlots = 16;
+    while( h.numSlots < 2*(h.numKeys - h.numLongKeys) ) {
+        h.numSlots *= 2;
+    }
+    std::vector<DictIndexState> states;
+    buildStates(keys, states);
+    h.numStates = states.size();
+    h.slotsOffset = align8(sizeof(h));
+    h.statesOffset = h.slotsOffset + h.numSlots*sizeof(DictIndexSlot);
+    h.longKeysOffset = h.statesOffset + h.numStates*sizeof(DictIndexState);
+    h.wordOffsetsOffset = h.longKeysOffset + h.numLongKeys*sizeof(DictIndexKey);
+    h.keyPoolOffset = h.wordOffsetsOffset + h.numWords*sizeof(uint32_t);
+    h.wordPoolOffset = h.keyPoolOffset + h.keyPoolSize;
+    h.imageSize = h.wordPoolOffset + h.wordPoolSize;
+
+    image.assign(h.imageSize, 0);
+    char *data = &image[0];
+    memcpy(data, &h, sizeof(h));
+    memcpy(data + h.statesOffset, &states[0], h.numStates*sizeof(DictIndexState));
+    DictIndexSlot *slots = (DictIndexSlot*)(data + h.slotsOffset);
+    DictIndexKey *longKeys = (DictIndexKey*)(data + h.longKeysOffset);
+    uint32_t *wordOffsets = (uint32_t*)(data + h.wordOffsetsOffset);
+    char *keyPool = data + h.keyPoolOffset;
+    char *wordPool = data + h.wordPoolOffset;
+
+    uint32_t mask = h.numSlots - 1;
+    uint32_t keyPos = 0, wordPos = 0, nword = 0;
+    for(size_t k=0; k<keys.numKeys(); ++k) {
+        const char *digits = keys.digits(k);
+        const uint32_t len = keys.length(k);
+        if( len > DictIndex::MAX_PACKED_DIGITS ) {
+            longKeys->keyOffset = keyPos;
+            longKeys->keyLength = len;
+            longKeys->firstWord = nword;
+            longKeys->numWords = keys.numWords(k);
+            ++longKeys;
+            memcpy(keyPool + keyPos, digits, len);
+            keyPos += len;
+        }else{
+            uint64_t key = packDigits(digits, len);
+            uint32_t i = hashPackedDigits(key, mask);
+            while( slots[i].key != 0 ) {
+                i = (i+1) & mask;
+            }
+            slots[i].key = key;
+            slots[i].firstWord = nword;
+            slots[i].numWords = keys.numWords(k);
+        }
+        for(uint32_t i=keys.keyFirst[k]; i<keys.keyFirst[k+1]; ++i) {
+            wordOffsets[nword++] = wordPos;
+            memcpy(wordPool + wordPos, keys.word(i), len + 1);
+            wordPos += len + 1;
+        }
+    }
+}
+
+// the image is written aside and renamed over the target, so processes
+// which still have the old index mapped keep a consistent view
+bool DictIndex::save(const char *filename) const {
+    if( !isOpen() ) return false;
+    std::string tmpname = std::string(filename) + ".tmp";
+    FILE *f = fopen(tmpname.c_str(), "wb");
+    if( f == NULL ) return false;
+    bool ok = fwrite(image, 1, header->imageSize, f) == header->imageSize;
+    ok = fclose(f) == 0 && ok;
+    if( ok && rename(tmpname.c_str(), filename) == 0 ) return true;
+    remove(tmpname.c_str());
+    return false;
+}
+
+} // namespace jz
@@ -0,0 +1,279 @@
+#ifndef DICTINDEX_H
+#define DICTINDEX_H
+
+#include <stddef.h>
+#include <stdint.h>
+#include <string>
+#include <vector>
+
+namespace jz{
+
+// Precompiled dictionary index.
+//
+// The index is a single flat image, so it can either be written to disk
+// and mmap'ed later, or kept in memory. All sections are arrays of plain
+// integers/chars referenced by offsets from the beginning of the image:
+//
+//     | header | slots[numSlots] | states[numStates] | longKeys[numLongKeys] |
+//     | wordOffsets[numWords] | key pool | word pool |
+//
+// Every key owns a contiguous range of wordOffsets, and each offset points
+// to a '\0' terminated word in the word pool. Words of a key keep the order
+// they had in the dictionary.
+//
+// Keys of up to MAX_PACKED_DIGITS digits are packed into 64 bits, 4 bits per
+// digit, and found in an open addressing hash table (linear probing, load
+// factor <= 1/2). The few longer keys are kept sorted by digit string in
+// longKeys, with their digits in the key pool, and found by binary search.
+//
+// All keys are also in an Aho-Corasick automaton (states), so every key in
+// a number can be found in one pass over its digits.
+struct DictIndexHeader {
+    char magic[8];          // "PHWDIDX"
+    uint32_t byteOrder;     // BYTE_ORDER_MARK, written in native order
+    uint32_t version;
+    uint32_t minWordLen;    // words shorter than this are not indexed
+    uint32_t numKeys;
+    uint32_t numWords;
+    uint32_t numSlots;      // power of 2
+    uint32_t numLongKeys;
+    uint32_t numStates;
+    uint32_t keyPoolSize;
+    uint32_t wordPoolSize;
+    uint32_t slotsOffset;
+    uint32_t statesOffset;
+    uint32_t longKeysOffset;
+    uint32_t wordOffsetsOffset;
+    uint32_t keyPoolOffset;
+    uint32_t wordPoolOffset;
+    uint32_t imageSize;
+};
+
+struct DictIndexSlot {
+    uint64_t key;           // packed digits, 0 for an empty slot
+    uint32_t firstWord;     // index in wordOffsets
+    uint32_t numWords;
+};
+
+// A state of the automaton is a prefix of some key; state 0 is the empty
+// prefix. States are numbered breadth first, so the children of a state
+// are consecutive, in digit order.
+struct DictIndexState {
+    uint32_t firstChild;
+    uint32_t fail;          // longest proper suffix that is a state
+    uint32_t output;        // longest proper suffix that is a key, 0 if none
+    uint32_t firstWord;     // index in wordOffsets, if the state is a key
+    uint32_t numWords;      // 0 if it is not
+    uint16_t childMask;     // bit d set if there is a child for digit d
+    uint16_t depth;         // number of digits
+};
+
+struct DictIndexKey {
+    uint32_t keyOffset;     // digits in the key pool
+    uint32_t keyLength;
+    uint32_t firstWord;     // index in wordOffsets
+    uint32_t numWords;
+};
+
+class DictIndex {
+public:
+    enum { VERSION = 3, BYTE_ORDER_MARK = 0x01020304, MAX_PACKED_DIGITS = 16 };
+
+    // range of words matching a digit key
+    struct Range {
+        uint32_t first, count;
+        Range(): first(0), count(0) {}
+    };
+
+    DictIndex();
+    ~DictIndex();
+
+    // map an index file written by save(). The pages are shared with every
+    // other process mapping the same file. The sections are checked once,
+    // so a corrupt file is refused instead of read out of bounds.
+    bool open(const char *filename);
+    // take over an image built by DictIndexBuilder
+    bool assign(std::vector<char>& image);
+    void close();
+    bool save(const char *filename) const;
+    bool isOpen() const {
+        return image != NULL;
+    }
+
+    Range find(const char *digits, size_t len) const;
+    Range find(uint64_t packed) const;
+
+    // Calls f(start, length, range) for every key in digits[0..len), in one
+    // pass with the automaton. Keys at the same end come longest first.
+    // Keys never span a character other than '0'..'9'.
+    template<typename F>
+    void forEachMatch(const char *digits, size_t len, F& f) const {
+        uint32_t s = 0;
+        for(size_t i=0; i<len; ++i) {
+            unsigned d = (unsigned char)digits[i] - '0';
+            if( d > 9 ) {
+                s = 0;
+                continue;
+            }
+            s = follow(s, d);
+            uint32_t o = states[s].numWords > 0 ? s : states[s].output;
+            for(; o != 0; o = states[o].output) {
+                const DictIndexState& st = states[o];
+                Range r;
+                r.first = st.firstWord;
+                r.count = st.numWords;
+                f(i + 1 - st.depth, st.depth, r);
+            }
+        }
+    }
+    const char* word(uint32_t i) const {
+        return wordPool + wordOffsets[i];
+    }
+    uint32_t numKeys() const {
+        return header->numKeys;
+    }
+    uint32_t numWords() const {
+        return header->numWords;
+    }
+    uint32_t minWordLength() const {
+        return header->minWordLen;
+    }
+    // the header, for the number and size of each section
+    const DictIndexHeader& layout() const {
+        return *header;
+    }
+    // mapped from a file rather than built in memory
+    bool isMapped() const {
+        return mappedSize != 0;
+    }
+
+private:
+    DictIndex(const DictIndex&);
+    DictIndex& operator=(const DictIndex&);
+
+    bool attach(const char *data, size_t size);
+    bool validate() const;
+    Range findLong(const char *digits, size_t len) const;
+
+    // the state after digit d, going down the failure links as needed
+    uint32_t follow(uint32_t s, unsigned d) const {
+        for(;;) {
+            const DictIndexState& st = states[s];
+            if( st.childMask & (1u << d) ) {
+                return st.firstChild + popcount16(st.childMask & ((1u << d) - 1));
+            }
+            if( s == 0 ) return 0;
+            s = st.fail;
+        }
+    }
+    static unsigned popcount16(unsigned x) {
+#ifdef __GNUC__
+        return __builtin_popcount(x);
+#else
+        unsigned n = 0;
+        for(; x; x &= x-1) ++n;
+        return n;
+#endif
+    }
+
+    const char *image;
+    size_t mappedSize;
+    std::vector<char> ownedImage;  // in-memory image, when not mapped
+    const DictIndexHeader *header;
+    const DictIndexSlot *slots;
+    const DictIndexState *states;
+    const DictIndexKey *longKeys;
+    const uint32_t *wordOffsets;
+    const char *keyPool;
+    const char *wordPool;
+};
+
+// Collects (digits, word) pairs and lays them out as a DictIndex image.
+//
+// The pairs are kept in two pools, digits and words at the same offsets, and
+// sorted by (digits, word, insertion order), which groups the words by
+// key and puts duplicates next to each other. A big dictionary can be split
+// into parts, each added to its own builder and sorted on its own thread,
+// and the sorted builders merged in dictionary order.
+class DictIndexBuilder {
+public:
+    explicit DictIndexBuilder(int minWordLen);
+
+    // words are kept in insertion order, duplicates of a key are dropped
+    void add(const std::string& digits, const std::string& word) {
+        add(digits.data(), word.data(), digits.length());
+    }
+    // one digit per letter, so both have len characters
+    void add(const char *digits, const char *word, size_t len);
+
+    // For parsers writing straight into the pools: room for n characters of
+    // digits and of words, at the same offsets. addReserved() adds the pair
+    // at pos of the room, and commit() keeps the first n characters. The
+    // pointers are valid until the next reserve().
+    void reserve(size_t n, char *&digits, char *&word) {
+        if( poolSize + n > digitPool.size() ) grow(poolSize + n);
+        digits = &digitPool[poolSize];
+        word = &wordPool[poolSize];
+    }
+    // writes the '\0' after the pair, at pos + len
+    void addReserved(size_t pos, size_t len) {
+        Entry e = { (uint32_t)(poolSize + pos), (uint32_t)len };
+        digitPool[e.offset + len] = '\0';
+        wordPool[e.offset + len] = '\0';
+        entries.push_back(e);
+        sorted = false;
+    }
+    void commit(size_t n) {
+        poolSize += n;
+    }
+
+    // sort the pairs and drop the duplicates
+    void sort();
+    // take over the pairs of other, which come after these ones in the
+    // dictionary. Sorted builders stay sorted.
+    void merge(DictIndexBuilder& other);
+
+    void build(std::vector<char>& image);
+
+    size_t size() const {
+        return entries.size();
+    }
+
+private:
+    // digits at digitPool[offset] and the word at wordPool[offset], both
+    // '\0' terminated
+    struct Entry {
+        uint32_t offset, length;
+    };
+    struct EntryLess;
+    struct EntryOrder;
+
+    void grow(size_t size);
+
+    std::vector<char> digitPool, wordPool;
+    uint32_t poolSize;  // committed, the pools are longer when grown by reserve()
+    std::vector<Entry> entries;
+    bool sorted;        // by EntryLess and without duplicates
+    int minWordLen;
+};
+
+// Packs up to MAX_PACKED_DIGITS digits as 4 bit codes 1..10, so that keys
+// of different length never collide. Returns 0 for anything else.
+inline uint64_t packDigits(const char *digits, size_t len) {
+    if( len > DictIndex::MAX_PACKED_DIGITS ) return 0;
+    uint64_t key = 0;
+    for(size_t i=0; i<len; ++i) {
+        unsigned d = (unsigned char)digits[i] - '0';
+        if( d > 9 ) return 0;
+        key = (key << 4) | (d + 1);
+    }
+    return key;
+}
+
+inline uint32_t hashPackedDigits(uint64_t key, uint32_t mask) {
+    return (uint32_t)((key * 0x9E3779B97F4A7C15ull) >> 32) & mask;
+}
+
+} // namespace jz
+
+#endif
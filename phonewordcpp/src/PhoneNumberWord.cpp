@@ -0,0 +1,457 @@
+#include <fcntl.h>
+#include <unistd.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <thread>
+#ifdef __SSE2__
+#include <emmintrin.h>
+#endif
+#include "PhoneNumberWord.h"
+#include "PhonewordText.h"
+
+namespace jz{
+
+PhoneNumberWord::PhoneNumberWord(): minWordLen(MIN_WORD_LEN), loadThreads(0), allocationCounter(NULL), maxResults(0), topResults(0), countOnly(false) {
+    //
+    CharStringMap d2a;
+    d2a[_T('2')] = _T("ABC");
+    d2a[_T('3')] = _T("DEF");
+    d2a[_T('4')] = _T("GHI");
+    d2a[_T('5')] = _T("JKL");
+    d2a[_T('6')] = _T("NMO");
+    d2a[_T('7')] = _T("PQRS");
+    d2a[_T('8')] = _T("TUV");
+    d2a[_T('9')] = _T("WXYZ");
+
+    memset(a2d, 0, sizeof(a2d));
+    for(CharStringMap::iterator it=d2a.begin(); it!=d2a.end(); ++it) {
+        String& w=it->second;
+        Char d = it->first;
+        for(String::iterator itc=w.begin(); itc!=w.end(); ++itc) {
+            a2d[(unsigned char)*itc] = d;
+        }
+    }
+    // the keys take the letters in alphabetical order
+    numKeyStarts = 0;
+    for(int c='B'; c<='Z'; ++c) {
+        if( a2d[c] != a2d[c-1] ) keyStarts[numKeyStarts++] = c;
+    }
+}
+
+// The text is encoded this many characters at a time, one bit per
+// character in the masks of encodeWindow()
+static const size_t ENCODE_WINDOW = 64;
+
+void PhoneNumberWord::encodeWindow(const char *s, size_t n, char *word, char *digits,
+                                   uint64_t& others, uint64_t& newlines) const {
+    others = 0;
+    newlines = 0;
+#ifdef __SSE2__
+    if( n == ENCODE_WINDOW ) {
+        // the digit of 'A', plus one for every key starting at or before the letter
+        __m128i starts[26];
+        for(int k=0; k<numKeyStarts; ++k) {
+            starts[k] = _mm_set1_epi8(keyStarts[k] - 1);
+        }
+        for(int b=0; b<4; ++b) {
+            const __m128i v = _mm_loadu_si128((const __m128i*)(s + 16*b));
+            // bytes from 0x80 are negative, so never letters
+            const __m128i lower = _mm_and_si128(_mm_cmpgt_epi8(v, _mm_set1_epi8('a' - 1)),
+                                                _mm_cmplt_epi8(v, _mm_set1_epi8('z' + 1)));
+            const __m128i upper = _mm_sub_epi8(v, _mm_and_si128(lower, _mm_set1_epi8('a' - 'A')));
+            const __m128i alpha = _mm_and_si128(_mm_cmpgt_epi8(upper, _mm_set1_epi8('A' - 1)),
+                                                _mm_cmplt_epi8(upper, _mm_set1_epi8('Z' + 1)));
+            __m128i d = _mm_set1_epi8(a2d['A']);
+            for(int k=0; k<numKeyStarts; ++k) {
+                d = _mm_sub_epi8(d, _mm_cmpgt_epi8(upper, starts[k]));
+            }
+            _mm_storeu_si128((__m128i*)(word + 16*b), upper);
+            _mm_storeu_si128((__m128i*)(digits + 16*b), d);
+            others |= (uint64_t)(~_mm_movemask_epi8(alpha) & 0xFFFF) << 16*b;
+            newlines |= (uint64_t)_mm_movemask_epi8(_mm_cmpeq_epi8(v, _mm_set1_epi8('\n'))) << 16*b;
+        }
+        return;
+    }
+#endif
+    for(size_t i=0; i<ENCODE_WINDOW; ++i) {
+        if( i >= n ) {
+            others |= 1ull << i;
+            newlines |= 1ull << i;
+            continue;
+        }
+        unsigned char c = s[i];
+        if( c >= 'a' && c <= 'z' ) c -= 'a' - 'A';
+        word[i] = c;
+        digits[i] = a2d[c];
+        if( c < 'A' || c > 'Z' ) others |= 1ull << i;
+        if( c == '\n' ) newlines |= 1ull << i;
+    }
+}
+
+// The whole chunk is case folded and encoded into the builder's pools, at the
+// same offsets as in the text. The masks then give the end of every word:
+// its first character other than a letter.
+void PhoneNumberWord::encodeLines(const char *text, size_t begin, size_t end,
+                                  DictIndexBuilder& builder, size_t& numWords) const {
+    text += begin;
+    const size_t n = end - begin;
+    char *digits, *word;
+    builder.reserve((n + ENCODE_WINDOW - 1) / ENCODE_WINDOW * ENCODE_WINDOW + 1, digits, word);
+    size_t line = 0;     // start of the current line
+    size_t pos = 0;      // first character not looked at yet
+    bool inWord = true;  // still in the letters at the start of the line
+    for(size_t w=0; w<n; w+=ENCODE_WINDOW) {
+        uint64_t others, newlines;
+        encodeWindow(text + w, std::min(ENCODE_WINDOW, n - w), word + w, digits + w, others, newlines);
+        while( pos < w + ENCODE_WINDOW ) {
+            const size_t from = pos > w ? pos - w : 0;
+            const uint64_t m = (inWord ? others : newlines) & (~0ull << from);
+            if( m == 0 ) break;
+            const size_t p = w + __builtin_ctzll(m);
+            pos = p + 1;
+            if( !inWord ) {
+                line = pos;
+                inWord = true;
+                continue;
+            }
+            if( line >= n ) break;
+            // a word ends with its line or at an apostrophe or hyphen, the
+            // rest of the line ignored; anything else drops the line
+            const char c = p < n ? text[p] : '\n';
+            if( c == '\n' || c == '\'' || c == '-' ) {
+                addWord(builder, line, p - line, numWords);
+            }
+            if( c == '\n' ) {
+                line = pos;
+            }else{
+                inWord = false;
+            }
+        }
+    }
+    if( inWord && line < n ) {
+        addWord(builder, line, n - line, numWords);  // last line, no newline
+    }
+    builder.commit(n + 1);
+}
+
+void PhoneNumberWord::addWord(DictIndexBuilder& builder, size_t pos, size_t len, size_t& numWords) const {
+    if( len >= (size_t)minWordLen ) {
+        ++numWords;
+        if( len > 1 ) builder.addReserved(pos, len);
+    }
+}
+
+void PhoneNumberWord::encodeChunk(const char *text, size_t begin, size_t end,
+                                  DictIndexBuilder *builder, size_t *numWords,
+                                  unsigned long long *allocated) const {
+    const unsigned long long bytes0 = allocated && allocationCounter ? allocationCounter() : 0;
+    encodeLines(text, begin, end, *builder, *numWords);
+    builder->sort();
+    if( allocated && allocationCounter ) *allocated += allocationCounter() - bytes0;
+}
+
+static void mergeBuilders(DictIndexBuilder *to, DictIndexBuilder *from,
+                          AllocationCounter counter, unsigned long long *allocated) {
+    const unsigned long long bytes0 = counter ? counter() : 0;
+    to->merge(*from);
+    if( counter ) *allocated += counter() - bytes0;
+}
+
+bool PhoneNumberWord::processDic(const char *text, size_t len) {
+    const long long t0 = monotonicNs();
+    size_t nthreads = loadThreads > 0 ? loadThreads : std::thread::hardware_concurrency();
+    nthreads = std::max<size_t>(1, std::min<size_t>(nthreads, len / MIN_LOAD_CHUNK));
+    // chunks of whole lines, in dictionary order
+    std::vector<size_t> bounds(1, 0);
+    for(size_t t=1; t<nthreads; ++t) {
+        const size_t b = std::max(len / nthreads * t, bounds.back());
+        const char *nl = (const char*)memchr(text + b, '\n', len - b);
+        bounds.push_back(nl ? nl - text + 1 : len);
+    }
+    bounds.push_back(len);
+
+    std::vector<DictIndexBuilder> builders(nthreads, DictIndexBuilder(minWordLen));
+    std::vector<size_t> numWords(nthreads, 0);
+    // by the workers, slot t for chunk t; the calling thread's go uncounted
+    std::vector<unsigned long long> allocated(nthreads, 0);
+    std::vector<std::thread> workers;
+    for(size_t t=1; t<nthreads; ++t) {
+        workers.push_back(std::thread(&PhoneNumberWord::encodeChunk, this, text, bounds[t], bounds[t+1],
+                                      &builders[t], &numWords[t], &allocated[t]));
+    }
+    encodeChunk(text, bounds[0], bounds[1], &builders[0], &numWords[0], NULL);
+    for(size_t t=0; t<workers.size(); ++t) {
+        workers[t].join();
+    }
+    // merge neighbours, pairs of them and so on, so that every merge takes
+    // the chunk right after the one merged into
+    for(size_t step=1; step<nthreads; step*=2) {
+        workers.clear();
+        for(size_t t=0; t+step<nthreads; t+=2*step) {
+            workers.push_back(std::thread(mergeBuilders, &builders[t], &builders[t+step],
+                                          allocationCounter, &allocated[t]));
+        }
+        for(size_t t=0; t<workers.size(); ++t) {
+            workers[t].join();
+        }
+    }
+    loadStats.numWords = 0;
+    loadStats.threadBytes = 0;
+    for(size_t t=0; t<nthreads; ++t) {
+        loadStats.numWords += numWords[t];
+        loadStats.threadBytes += allocated[t];
+    }
+
+    const long long t1 = monotonicNs();
+    std::vector<char> image;
+    builders[0].build(image);
+    bool ok = index.assign(image);
+    loadStats.encodeNs = t1 - t0;
+    loadStats.buildNs = monotonicNs() - t1;
+    return ok;
+}
+
+bool PhoneNumberWord::loadWeights(const char *filename) {
+    Ifstream file(filename);
+    if( !file.is_open() || !index.isOpen() ) return false;
+    std::unordered_map<String, double> w;
+    String word;
+    double v;
+    while( file >> word >> v ) {
+        std::transform(word.begin(), word.end(), word.begin(), ::toupper);
+        w[word] = v;
+    }
+    weights.assign(index.numWords(), 1.0);
+    for(uint32_t i=0; i<index.numWords(); ++i) {
+        std::unordered_map<String, double>::const_iterator it = w.find(index.word(i));
+        if( it != w.end() ) weights[i] = it->second;
+    }
+    return true;
+}
+
+bool PhoneNumberWord::loadDict(const char *filename) {
+    loadStats = LoadStats();
+    const long long t0 = monotonicNs();
+    int fd = ::open(filename, O_RDONLY);
+    if( fd < 0 ) return false;
+    struct stat st;
+    if( fstat(fd, &st) == 0 && S_ISREG(st.st_mode) && st.st_size > 0 ) {
+        // parse the file where it is, in the page cache
+        int flags = MAP_PRIVATE;
+#ifdef MAP_POPULATE
+        flags |= MAP_POPULATE;
+#endif
+        void *p = mmap(NULL, st.st_size, PROT_READ, flags, fd, 0);
+        ::close(fd);
+        if( p == MAP_FAILED ) return false;
+        loadStats.readNs = monotonicNs() - t0;
+        bool ok = processDic((const char*)p, st.st_size);
+        munmap(p, st.st_size);
+        return ok;
+    }
+    // pipes and the like are read into memory first
+    std::vector<char> text;
+    const size_t BLOCK = 1 << 20;
+    for(;;) {
+        const size_t n = text.size();
+        text.resize(n + BLOCK);
+        ssize_t r = ::read(fd, &text[n], BLOCK);
+        text.resize(n + (r > 0 ? r : 0));
+        if( r <= 0 ) break;
+    }
+    ::close(fd);
+    loadStats.readNs = monotonicNs() - t0;
+    return processDic(text.empty() ? "" : &text[0], text.size());
+}
+
+void PhoneNumberWord::findWord(const String& adigits, Ostream& os, Scratch& scratch) const {
+    // with statistics every write to os is timed into outputNs
+    MatchStats* stats = scratch.stats;
+    if( countOnly ) {
+        bool saturated = false;
+        unsigned long long n = countCombinations(adigits, saturated, scratch);
+        const long long t0 = stats ? monotonicNs() : 0;
+        if( n == 0 ) {
+            os << "No digits in " << adigits << std::endl;
+        }else{
+            os << n << (saturated ? "+" : "") << std::endl;
+        }
+        if( stats ) stats->outputNs += monotonicNs() - t0;
+        return;
+    }
+    OstreamSink out(os);
+    bool found;
+    if( stats ) {
+        TimedSink<OstreamSink> timed(out, stats->outputNs);
+        found = forEachCombination(adigits, timed, scratch);
+    }else{
+        found = forEachCombination(adigits, out, scratch);
+    }
+    if( !found ) {
+        const long long t0 = stats ? monotonicNs() : 0;
+        os << "No digits in " << adigits << std::endl;
+        if( stats ) stats->outputNs += monotonicNs() - t0;
+    }
+}
+
+unsigned long long PhoneNumberWord::countCombinations(const String& adigits, bool& saturated, Scratch& scratch) const {
+    MatchStats* stats = scratch.stats;
+    const long long t0 = stats ? monotonicNs() : 0;
+    extractDigits(adigits, scratch.digits);
+    const int N = scratch.digits.length();
+    saturated = false;
+    if( N == 0 ) return 0;
+    scratch.m.reset(N+1, N);
+    fillMatrix(scratch.digits, scratch.m, stats);
+    const long long t1 = stats ? monotonicNs() : 0;
+    computeSteps(scratch.m, scratch.dag.steps);
+    countSuffixes(scratch.m, scratch.dag.steps, scratch.count, saturated);
+    if( stats ) stats->addNumber(t1 - t0, monotonicNs() - t1, scratch.count[0]);
+    return scratch.count[0];
+}
+
+void PhoneNumberWord::countSuffixes(const WordRangeMatrix& m, const std::vector<Step>& steps,
+                                    std::vector<unsigned long long>& count, bool& saturated) const {
+    const int N = m.NCOL;
+    const unsigned long long MAX = std::numeric_limits<unsigned long long>::max();
+    count.assign(N+1, 0);
+    count[N] = 1;
+    for(int p=N-1; p>=0; --p) {
+        const Step& st = steps[p];
+        if( st.minStep == 0 ) {
+            count[p] = 1;
+            continue;
+        }
+        unsigned long long c = st.skipTo > 0 ? count[st.skipTo] : 0;
+        for(int i=st.minStep; i<m.NROW; ++i) {
+            unsigned long long words = m(i,st.minStart).count;
+            if( words == 0 ) continue;  // a word would end past N
+            unsigned long long rest = count[st.minStart+i];
+            if( rest == 0 ) continue;
+            if( rest > (MAX - c) / words ) {
+                c = MAX;
+                saturated = true;
+                break;
+            }
+            c += words * rest;
+        }
+        count[p] = c;
+    }
+}
+
+void PhoneNumberWord::fillMatrix(const String& digits, WordRangeMatrix& m, MatchStats* stats) const {
+    const size_t N = digits.length();
+    size_t i = 0;
+    while( i < N ) {
+        while( i < N && isSep(digits[i]) ) ++i;
+        size_t j = i;
+        while( j < N && !isSep(digits[j]) ) ++j;
+        MatchFiller filler(m, i, minWordLen, stats);
+        index.forEachMatch(digits.data() + i, j - i, filler);
+        if( stats ) stats->lookups += j - i;
+        i = j;
+    }
+}
+
+void PhoneNumberWord::printMatrix( WordRangeMatrix& m, Ostream& os ) const {
+    os << "<startPos, length: matched Strings>" << std::endl;
+    for(int i=minWordLen; i<m.NROW; ++i) {
+        for(int j=0; j<m.NCOL; ++j) {
+            const WordRange& r = m(i,j);
+            if( r.count > 0 ) {
+                os << "<" << j << "," << i << ":";
+                for(uint32_t k=r.first; k<r.first+r.count; ++k) {
+                    os << index.word(k) << " ";
+                }
+                os << ">" << std::endl;
+            }
+        }
+    }
+}
+
+void PhoneNumberWord::buildSuffixDag(const String& digits, const WordRangeMatrix& m, Scratch& scratch) const {
+    const int N = digits.length();
+    SuffixDag& dag = scratch.dag;
+    std::vector<unsigned long long>& count = scratch.count;
+    String& head = scratch.head;
+    computeSteps(m, dag.steps);
+    bool saturated = false;
+    countSuffixes(m, dag.steps, count, saturated);
+    dag.first.assign(N+1, 0);
+    dag.num.assign(N+1, 0);
+    dag.start.clear();
+    dag.length.clear();
+    dag.pool.clear();
+    head.clear();
+    addSuffix(dag, head, N);
+    // a suffix has no more combinations than any position before it
+    // that leads to it, so the suffixes needed are always rendered
+    for(int p=N-1; p>=0; --p) {
+        if( count[p] > MAX_RENDERED_SUFFIXES ) continue;
+        const Step& st = dag.steps[p];
+        if( st.minStep == 0 ) {
+            head.clear();
+            appendDigits(head, digits, p, N, false);
+            addSuffix(dag, head, p);
+            continue;
+        }
+        for(int i=st.minStep; i<m.NROW; ++i) {
+            const WordRange& r = m(i,st.minStart);
+            for(uint32_t k=r.first; k<r.first+r.count; ++k) {
+                head.clear();
+                appendDigits(head, digits, p, st.minStart, false);
+                appendWord(head, index.word(k));
+                addSuffixes(dag, head, true, st.minStart+i, p, scratch.suffix);
+            }
+        }
+        if( st.skipTo > 0 ) {
+            head.clear();
+            appendDigits(head, digits, p, st.skipTo, false);
+            addSuffixes(dag, head, false, st.skipTo, p, scratch.suffix);
+        }
+    }
+}
+
+void PhoneNumberWord::addSuffixes(SuffixDag& dag, const String& head, bool afterWord, int from, int p, String& s) const {
+    for(uint32_t j=dag.first[from]; j<dag.first[from]+dag.num[from]; ++j) {
+        s = head;
+        appendSuffix(s, afterWord, dag.pool.data() + dag.start[j], dag.length[j]);
+        addSuffix(dag, s, p);
+    }
+}
+
+void PhoneNumberWord::addSuffix(SuffixDag& dag, const String& s, int p) {
+    if( dag.num[p] == 0 ) dag.first[p] = dag.start.size();
+    dag.start.push_back(dag.pool.length());
+    dag.length.push_back(s.length());
+    dag.pool += s;
+    ++dag.num[p];
+}
+
+void PhoneNumberWord::computeSteps(const WordRangeMatrix& m, std::vector<Step>& steps) const {
+    const int NR = m.NROW;
+    const int N = m.NCOL;
+    steps.resize(N);
+    Step next = { N, 0, 0 };  // first match at or after p
+    for(int p=N-1; p>=0; --p) {
+        for(int i=minWordLen; i<NR; ++i) {
+            if( m(i,p).count > 0 ) {
+                next.minStart = p;
+                next.minStep = i;
+                break;
+            }
+        }
+        Step& st = steps[p];
+        st.minStart = next.minStep > 0 ? next.minStart : p;
+        st.minStep = next.minStep;
+        st.skipTo = 0;
+        if( st.minStep > 0 && st.minStart+1 < N ) {
+            const Step& after = steps[st.minStart+1];
+            if( after.minStep > 0 && after.minStart <= st.minStep ) {
+                st.skipTo = after.minStart;
+            }
+        }
+    }
+}
+
+} // namespace jz
@@ -0,0 +1,716 @@
+#ifndef PHONENUMBERWORD_H
+#define PHONENUMBERWORD_H
+
+#include <string.h>
+#include <stdlib.h>
+#include <ctype.h>
+#include <iostream>
+#include <algorithm>
+#include <fstream>
+#include <sstream>
+#include <list>
+#include <vector>
+#include <iterator>
+#include <unordered_map>
+#include <memory>
+#include <queue>
+#include <limits>
+#include <assert.h>
+#include <time.h>
+#include "DictIndex.h"
+
+namespace jz{
+#ifdef _UNICODE
+typedef wchar_t Char;
+typedef ::std::wstring String;
+typedef ::std::wifstream Ifstream;
+typedef ::std::wofstream Ofstream;
+typedef ::std::wstringstream Stringstream;
+typedef ::std::wostream Ostream;
+#else
+typedef char Char;
+typedef ::std::string String;
+typedef ::std::ifstream Ifstream;
+typedef ::std::ofstream Ofstream;
+typedef ::std::stringstream Stringstream;
+typedef ::std::ostream Ostream;
+#endif
+
+
+typedef std::list<String> StringList;
+typedef std::unordered_map<Char, Char> CharCharMap;
+typedef std::unordered_map<Char, String> CharStringMap;
+
+template <typename T>
+class Matrix {
+    std::vector<T> data;
+
+    Matrix(const Matrix&){}
+    Matrix& operator=(const Matrix&){}
+public:
+    typedef Matrix<T> ThisType;
+    int NROW, NCOL, SIZE;
+
+    Matrix(): NROW(0), NCOL(0), SIZE(0) {}
+    Matrix(std::size_t nrow, std::size_t ncol)
+        : NROW(nrow), NCOL(ncol), SIZE(nrow*ncol), data(nrow*ncol)
+    {}
+    // nrow x ncol cells, all cleared, in the memory already allocated
+    void reset(std::size_t nrow, std::size_t ncol) {
+        NROW = nrow;
+        NCOL = ncol;
+        SIZE = nrow*ncol;
+        data.assign(SIZE, T());
+    }
+    inline std::size_t size() const {
+        return SIZE;
+    }
+    inline T& operator[](std::size_t i) {
+        assert(i<SIZE);
+        return data[i];
+    }
+    T& operator()(std::size_t i, std::size_t j) {
+        assert(i < NROW && j < NCOL);
+        return (*this)[i*NCOL +j];
+    }
+    const T& operator()(std::size_t i, std::size_t j) const{
+        ThisType& me = const_cast<ThisType&>(*this);
+        return me(i,j);
+    }
+};
+
+// words matching a cell are a range of the flat word pool in DictIndex
+typedef DictIndex::Range WordRange;
+typedef Matrix<WordRange> WordRangeMatrix;
+
+// Sinks receive the combinations found by PhoneNumberWord::forEachCombination().
+// operator() returns false to stop the enumeration.
+struct OstreamSink {
+    Ostream& os;
+    explicit OstreamSink(Ostream& os): os(os) {}
+    bool operator()(const String& s) {
+        os << s << Char('\n');
+        return true;
+    }
+};
+
+struct CountSink {
+    unsigned long long count;
+    CountSink(): count(0) {}
+    bool operator()(const String&) {
+        ++count;
+        return true;
+    }
+};
+
+// forwards the first `limit` combinations to another sink
+template<typename Sink>
+struct LimitSink {
+    Sink& sink;
+    size_t left;
+    LimitSink(Sink& sink, size_t limit): sink(sink), left(limit) {}
+    bool operator()(const String& s) {
+        return left > 0 && sink(s) && --left > 0;
+    }
+};
+
+// counts the combinations passed on to another sink
+template<typename Sink>
+struct CountingSink {
+    Sink& sink;
+    unsigned long long count;
+    explicit CountingSink(Sink& sink): sink(sink), count(0) {}
+    bool operator()(const String& s) {
+        ++count;
+        return sink(s);
+    }
+};
+
+// monotonic time in nanoseconds, for the statistics
+inline long long monotonicNs() {
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return ts.tv_sec * 1000000000LL + ts.tv_nsec;
+}
+
+// times another sink, adding the ns spent in it to `ns`
+template<typename Sink>
+struct TimedSink {
+    Sink& sink;
+    long long& ns;
+    TimedSink(Sink& sink, long long& ns): sink(sink), ns(ns) {}
+    bool operator()(const String& s) {
+        const long long t0 = monotonicNs();
+        const bool more = sink(s);
+        ns += monotonicNs() - t0;
+        return more;
+    }
+};
+
+// Bytes allocated so far by the calling thread, for programs that count
+// their allocations; see PhoneNumberWord::setAllocationCounter().
+typedef unsigned long long (*AllocationCounter)();
+
+// Time spent loading, by phase, in ns.
+struct LoadStats {
+    long long readNs;       // reading the dictionary, or mapping the index
+    long long encodeNs;     // words to digits, grouped by key
+    long long buildNs;      // laying out the index
+    size_t numWords;        // words read from the dictionary
+    unsigned long long threadBytes; // allocated on the loader threads, with an AllocationCounter
+    LoadStats(): readNs(0), encodeNs(0), buildNs(0), numWords(0), threadBytes(0) {}
+};
+
+// Latencies in ns, counted in buckets 1/16 of a power of 2 wide, so the
+// memory is the same however many numbers are measured. A percentile is the
+// upper bound of its bucket, at most 1/16 above the exact value; count, sum,
+// min and max are exact.
+struct LatencyHistogram {
+    enum { SUB_BITS = 4, SUB = 1 << SUB_BITS, NUM_BUCKETS = (64 - SUB_BITS + 1) * SUB };
+    unsigned long long counts[NUM_BUCKETS];
+    unsigned long long count;
+    long long sum, min, max;
+    LatencyHistogram(): count(0), sum(0), min(0), max(0) {
+        memset(counts, 0, sizeof(counts));
+    }
+
+    void add(long long ns) {
+        if( ns < 0 ) ns = 0;
+        ++counts[bucket(ns)];
+        if( count == 0 || ns < min ) min = ns;
+        if( ns > max ) max = ns;
+        ++count;
+        sum += ns;
+    }
+    void merge(const LatencyHistogram& o) {
+        if( o.count == 0 ) return;
+        for(int i=0; i<NUM_BUCKETS; ++i) counts[i] += o.counts[i];
+        if( count == 0 || o.min < min ) min = o.min;
+        if( o.max > max ) max = o.max;
+        count += o.count;
+        sum += o.sum;
+    }
+    // nearest rank, 0 if nothing was added
+    long long percentile(int p) const {
+        unsigned long long rank = (count * p + 99) / 100;
+        if( rank == 0 ) rank = 1;
+        unsigned long long seen = 0;
+        for(int i=0; i<NUM_BUCKETS && count > 0; ++i) {
+            seen += counts[i];
+            if( seen >= rank ) return std::min(upperBound(i), max);
+        }
+        return max;
+    }
+
+private:
+    // values below SUB have a bucket each, the others SUB buckets for
+    // every power of 2
+    static int bucket(unsigned long long v) {
+        if( v < SUB ) return (int)v;
+        const int e = log2(v);
+        return (e - SUB_BITS + 1) * SUB + (int)((v >> (e - SUB_BITS)) & (SUB - 1));
+    }
+    static long long upperBound(int i) {
+        if( i < SUB ) return i;
+        const int e = i / SUB + SUB_BITS - 1;
+        const unsigned long long sub = i % SUB;
+        return (long long)(((SUB + sub + 1) << (e - SUB_BITS)) - 1);
+    }
+    static int log2(unsigned long long v) {
+#ifdef __GNUC__
+        return 63 - __builtin_clzll(v);
+#else
+        int e = 0;
+        while( v >>= 1 ) ++e;
+        return e;
+#endif
+    }
+};
+
+// Statistics of the lookups of one thread, collected while a Scratch points
+// to it. Without one nothing is counted or timed.
+struct MatchStats {
+    unsigned long long numbers;
+    unsigned long long lookups;       // automaton steps, one per digit
+    unsigned long long hits;          // keys found in the numbers
+    unsigned long long cells;         // matrix cells filled, keys of words long enough
+    unsigned long long combinations;  // emitted, or counted with countOnly
+    long long matchNs, enumerateNs;
+    long long outputNs;               // findWord() writing to its stream, not in enumerateNs
+    LatencyHistogram latency;         // match + enumerate of each number
+    MatchStats(): numbers(0), lookups(0), hits(0), cells(0), combinations(0),
+                  matchNs(0), enumerateNs(0), outputNs(0) {}
+
+    void addNumber(long long match, long long enumerate, unsigned long long n) {
+        ++numbers;
+        matchNs += match;
+        enumerateNs += enumerate;
+        latency.add(match + enumerate);
+        addCombinations(n);
+    }
+    void merge(const MatchStats& o) {
+        numbers += o.numbers;
+        lookups += o.lookups;
+        hits += o.hits;
+        cells += o.cells;
+        addCombinations(o.combinations);
+        matchNs += o.matchNs;
+        enumerateNs += o.enumerateNs;
+        outputNs += o.outputNs;
+        latency.merge(o.latency);
+    }
+    // saturating, like the counts of countCombinations()
+    void addCombinations(unsigned long long n) {
+        const unsigned long long MAX = std::numeric_limits<unsigned long long>::max();
+        combinations = n > MAX - combinations ? MAX : combinations + n;
+    }
+};
+
+
+// Finds the words hidden in phone numbers. The dictionary is loaded (or an
+// index mapped) once; after that the lookups only read the object, so any
+// number of threads can share it, each passing its own Scratch.
+struct PhoneNumberWord {
+    // dictionaries smaller than a chunk per thread take fewer threads
+    enum { MAX_LINE_LEN = 128, MIN_WORD_LEN = 2, MIN_LOAD_CHUNK = 256*1024 };
+    static const Char SEP = '-';
+    struct Scratch;
+    int minWordLen;
+    int loadThreads;   // for loadDict(), 0 for the number of cores
+    AllocationCounter allocationCounter; // NULL if the allocations are not counted
+    size_t maxResults; // combinations per number, 0 for all
+    size_t topResults; // rank and keep the best ones, 0 for no ranking
+    bool countOnly;
+    LoadStats loadStats; // of the last loadDict()/processDic()/loadIndex()
+
+    PhoneNumberWord();
+
+    // encode the words of a dictionary, one per line, and lay them out as
+    // an in-memory index: one flat pool of words grouped by number. Big
+    // dictionaries are split into chunks encoded and sorted in parallel.
+    bool processDic(const char *text, size_t len);
+
+    // threads to load a dictionary with, 0 for the number of cores
+    void setLoadThreads(int n) {
+        loadThreads = n;
+    }
+    // the loader threads add what they allocate to loadStats.threadBytes;
+    // the calling thread's allocations are the caller's to count
+    void setAllocationCounter(AllocationCounter counter) {
+        allocationCounter = counter;
+    }
+
+    void setMinWordLength(int len) {
+        minWordLen = len;
+    }
+
+    // 0 for no limit
+    void setMaxResults(size_t n) {
+        maxResults = n;
+    }
+
+    // print the number of combinations instead of the combinations
+    void setCountOnly(bool on) {
+        countOnly = on;
+    }
+
+    // only produce the n highest scoring combinations, best first; 0 for
+    // all of them in dictionary order
+    void setTopResults(size_t n) {
+        topResults = n;
+    }
+
+    // Per word multipliers for the ranking score, one "word weight" pair per
+    // line (e.g. word frequencies). Words not listed keep weight 1.
+    // The dictionary or index has to be loaded first.
+    bool loadWeights(const char *filename);
+
+    bool loadDict(const char *filename = "/usr/share/dict/words");
+
+    // map a precompiled index (see saveIndex()); lookups are then served
+    // straight from the mapped pages and the word list is not needed.
+    bool loadIndex(const char *filename) {
+        loadStats = LoadStats();
+        const long long t0 = monotonicNs();
+        bool ok = index.open(filename);
+        loadStats.readNs = monotonicNs() - t0;
+        return ok;
+    }
+
+    // write the index built by loadDict() to a file
+    bool saveIndex(const char *filename) const {
+        return index.save(filename);
+    }
+
+    // dynamic programming to store matched words
+    //                     Matched String Matrix
+    //             _____________ startPos ___________________
+    //             |         0            1        2        3
+    //             | 2       AD
+    // wordLength  | 3       BOB,BIZ
+    //             | 4
+    //
+    void findWord(const String& adigits, Ostream& os) const {
+        Scratch scratch;
+        findWord(adigits, os, scratch);
+    }
+    void findWord(const String& adigits, Ostream& os, Scratch& scratch) const;
+
+    // The combinations from startpos on are: the digits up to minStart, the
+    // first position with a match, followed by any word matched there; plus
+    // the digits up to skipTo, the next position with a match before
+    // minStep, followed by the combinations from there. minStep is the
+    // shortest word length at minStart, or 0 if nothing matches after
+    // startpos; skipTo is 0 if there is no such position.
+    struct Step {
+        int minStart, minStep, skipTo;
+    };
+
+    // Number of combinations findWord() would print, without generating
+    // them, in O(digits * word lengths). Counts saturate at the largest
+    // unsigned long long, which sets `saturated`.
+    unsigned long long countCombinations(const String& adigits, bool& saturated) const {
+        Scratch scratch;
+        return countCombinations(adigits, saturated, scratch);
+    }
+    unsigned long long countCombinations(const String& adigits, bool& saturated, Scratch& scratch) const;
+
+    // count[p], the number of combinations from position p on, is the sum
+    // over the branches of steps[p], computed back to front.
+    void countSuffixes(const WordRangeMatrix& m, const std::vector<Step>& steps,
+                       std::vector<unsigned long long>& count, bool& saturated) const;
+
+    // Passes every combination to sink(const String&), which returns false
+    // to stop the enumeration. Nothing is stored, so memory does not grow
+    // with the number of combinations. At most maxResults combinations are
+    // produced if it is set.
+    // Returns false if there are no digits in adigits.
+    template<typename Sink>
+    bool forEachCombination(const String& adigits, Sink& sink) const {
+        Scratch scratch;
+        return forEachCombination(adigits, sink, scratch);
+    }
+    template<typename Sink>
+    bool forEachCombination(const String& adigits, Sink& sink, Scratch& scratch) const {
+        MatchStats* stats = scratch.stats;
+        const long long t0 = stats ? monotonicNs() : 0;
+        extractDigits(adigits, scratch.digits);
+        const size_t N = scratch.digits.length();
+        if( N == 0) {
+            return false;
+        }
+        scratch.m.reset(N+1, N);
+        fillMatrix(scratch.digits, scratch.m, stats);
+        if( stats ) {
+            // a TimedSink in findWord() takes its writes out of the enumeration
+            const long long t1 = monotonicNs();
+            const long long output0 = stats->outputNs;
+            CountingSink<Sink> counted(sink);
+            enumerateLimited(counted, scratch);
+            const long long enumerate = monotonicNs() - t1 - (stats->outputNs - output0);
+            stats->addNumber(t1 - t0, enumerate, counted.count);
+        }else{
+            enumerateLimited(sink, scratch);
+        }
+        return true;
+    }
+    template<typename Sink>
+    void enumerateLimited(Sink& sink, Scratch& scratch) const {
+        if( maxResults > 0 ) {
+            LimitSink<Sink> limited(sink, maxResults);
+            enumerateWords(scratch.digits, scratch.m, limited, scratch);
+        }else{
+            enumerateWords(scratch.digits, scratch.m, sink, scratch);
+        }
+    }
+
+    template<typename Sink>
+    void enumerateWords(const String& digits, const WordRangeMatrix& m, Sink& sink, Scratch& scratch) const {
+        if( topResults > 0 ) {
+            rankWords(digits, m, topResults, sink);
+        }else{
+            printWords(digits, m, sink, scratch);
+        }
+    }
+
+    static void extractDigits(const String& adigits, String& digits) {
+        digits.clear();
+        for(int i=0; i< adigits.length(); ++i) // ignore all non-digits
+            if( isdigit(adigits[i]) )
+                digits += adigits[i];
+    }
+
+    // every dictionary key in the digits, found by running the index's
+    // automaton once over each stretch of digits between separators
+    // The matches are counted into stats if it is set.
+    void fillMatrix(const String& digits, WordRangeMatrix& m, MatchStats* stats = NULL) const;
+    // stores the range of words matched at each (start, length); nothing
+    // is copied
+    struct MatchFiller {
+        WordRangeMatrix& m;
+        size_t offset;
+        int minWordLen;
+        MatchStats* stats;
+        MatchFiller(WordRangeMatrix& m, size_t offset, int minWordLen, MatchStats* stats)
+            : m(m), offset(offset), minWordLen(minWordLen), stats(stats) {}
+        void operator()(size_t start, size_t length, const WordRange& r) {
+            if( stats ) ++stats->hits;
+            if( (int)length >= minWordLen ) {
+                m(length, offset + start) = r;
+                if( stats ) ++stats->cells;
+            }
+        }
+    };
+    static bool isSep(Char c) {
+        return !isdigit(c) || c == '1' || c == '0';
+    }
+
+
+    void printMatrix( WordRangeMatrix& m, Ostream& os ) const;
+
+    // The combinations of a number form a DAG: steps[p] gives the branches
+    // out of position p. Positions with at most MAX_RENDERED_SUFFIXES
+    // combinations after them also have those rendered once, in order, so
+    // every prefix reaching such a position just appends them instead of
+    // walking the rest of the DAG again.
+    enum { MAX_RENDERED_SUFFIXES = 64 };
+    struct SuffixDag {
+        std::vector<Step> steps;
+        std::vector<uint32_t> first, num;  // suffixes of a position, num 0 if not rendered
+        std::vector<uint32_t> start, length;  // of each suffix in pool
+        String pool;
+    };
+
+    // working memory of the lookups, see PhoneNumberWord
+    struct Scratch {
+        String digits;
+        WordRangeMatrix m;
+        SuffixDag dag;
+        std::vector<unsigned long long> count;  // combinations from each position
+        String buf, head, suffix;
+        MatchStats* stats;  // the lookups are counted and timed into it, if set
+        Scratch(): stats(NULL) {}
+    };
+
+    // builds scratch.dag, using the rest of scratch but digits and m
+    void buildSuffixDag(const String& digits, const WordRangeMatrix& m, Scratch& scratch) const;
+    // head followed by each suffix of position `from`, as suffixes of p
+    void addSuffixes(SuffixDag& dag, const String& head, bool afterWord, int from, int p, String& s) const;
+    static void addSuffix(SuffixDag& dag, const String& s, int p);
+    // A suffix is rendered as if it began the combination, so the
+    // separator in front of it is added here, by the rules of
+    // appendDigits()/appendWord().
+    static void appendSuffix(String& buf, bool afterWord, const Char *suffix, size_t len) {
+        if( len == 0 ) return;
+        if( isdigit(suffix[0]) ? afterWord : !buf.empty() ) buf += SEP;
+        buf.append(suffix, len);
+    }
+
+    template<typename Sink>
+    void printWords(const String& digits, const WordRangeMatrix& m, Sink& sink, Scratch& scratch) const {
+        buildSuffixDag(digits, m, scratch);
+        String& buf = scratch.buf;
+        buf.clear();
+        buf.reserve(digits.length()*2 + 1);
+        combineWords(0, digits, m, scratch.dag, buf, false, sink);
+    }
+
+    // Every combination is built in the one buffer: a segment is appended
+    // before recursing and cut off again afterwards. Separators only go next
+    // to words (adjacent digit segments merge), so the buffer always holds
+    // the final form and is handed to the sink as is.
+    // Returns false once the sink asked to stop.
+    template<typename Sink>
+    bool combineWords(int startpos, const String& digits, const WordRangeMatrix& m, const SuffixDag& dag,
+                      String& buf, bool afterWord, Sink& sink) const {
+        const int NR = m.NROW;
+        const int N = digits.length();
+        const size_t len0 = buf.length();
+        bool more = true;
+        if( dag.num[startpos] > 0 ) { // the rest is rendered already
+            const uint32_t end = dag.first[startpos] + dag.num[startpos];
+            for(uint32_t j=dag.first[startpos]; j<end && more; ++j) {
+                appendSuffix(buf, afterWord, dag.pool.data() + dag.start[j], dag.length[j]);
+                const String& combination = buf;
+                more = sink(combination);
+                buf.resize(len0);
+            }
+            return more;
+        }
+        const Step& st = dag.steps[startpos];
+        const int minStart = st.minStart;
+        if( st.minStep == 0 ) {
+            appendDigits(buf, digits, startpos, N, afterWord);
+            more = combineWords(N, digits, m, dag, buf, false, sink);
+            buf.resize(len0);
+            return more;
+        }
+        appendDigits(buf, digits, startpos, minStart, afterWord);
+        const size_t len1 = buf.length();
+        for(int i=st.minStep; i<NR && more; ++i) {
+            const WordRange& r = m(i,minStart);
+            for(uint32_t k=r.first; k<r.first+r.count && more; ++k) {
+                appendWord(buf, index.word(k));
+                more = combineWords(minStart+i, digits, m, dag, buf, true, sink);
+                buf.resize(len1);
+            }
+        }
+        buf.resize(len0);
+        if( more && st.skipTo > 0 ) {
+            appendDigits(buf, digits, startpos, st.skipTo, afterWord);
+            more = combineWords(st.skipTo, digits, m, dag, buf, false, sink);
+            buf.resize(len0);
+        }
+        return more;
+    }
+
+    // the Step of every position, back to front in O(N*L)
+    void computeSteps(const WordRangeMatrix& m, std::vector<Step>& steps) const;
+
+    // score of a word in the ranking: length squared, times its weight
+    double wordScore(uint32_t word, int length) const {
+        double w = weights.empty() ? 1.0 : weights[word];
+        return length * length * w;
+    }
+
+    // Best-first search for the `limit` highest scoring combinations, which
+    // are passed to the sink best first.
+    // best[p] is the highest score the combinations from position p on can
+    // still collect. It is exact, so a partial combination leaves the queue
+    // only when no other one can beat it: finished combinations come out in
+    // descending order and branches that can't make it into the top are
+    // never expanded.
+    // Every prefix of a best combination has the same bound, and with length
+    // squared scores many of them tie. Ties are taken newest first, so the
+    // search goes depth first among them instead of expanding every tied
+    // prefix of a long number; tied combinations come out in no set order.
+    template<typename Sink>
+    void rankWords(const String& digits, const WordRangeMatrix& m, size_t limit, Sink& sink) const {
+        const int NR = m.NROW;
+        const int N = digits.length();
+        std::vector<Step> steps;
+        computeSteps(m, steps);
+        std::vector<double> best(N+1, 0.0);
+        for(int p=N-1; p>=0; --p) {
+            const Step& st = steps[p];
+            if( st.minStep == 0 ) continue;
+            double b = -std::numeric_limits<double>::infinity();
+            for(int i=st.minStep; i<NR; ++i) {
+                const WordRange& r = m(i,st.minStart);
+                for(uint32_t k=r.first; k<r.first+r.count; ++k) {
+                    b = std::max(b, wordScore(k, i) + best[st.minStart+i]);
+                }
+            }
+            if( st.skipTo > 0 ) {
+                b = std::max(b, best[st.skipTo]);
+            }
+            best[p] = b;
+        }
+
+        // a partial combination: the digits after the parent's position up
+        // to digitsEnd, then an optional word, leading to pos
+        struct Node {
+            int parent, digitsEnd, pos;
+            uint32_t word;
+            double score;
+        };
+        struct Entry {
+            double bound;
+            size_t node;
+            bool operator<(const Entry& o) const { // max bound first, then LIFO
+                return bound < o.bound || (bound == o.bound && node < o.node);
+            }
+        };
+        const uint32_t NO_WORD = ~0u;
+        std::vector<Node> nodes;
+        std::priority_queue<Entry> queue;
+        Node root = { -1, 0, 0, NO_WORD, 0.0 };
+        nodes.push_back(root);
+        Entry e0 = { best[0], 0 };
+        queue.push(e0);
+        String buf;
+        std::vector<size_t> path;
+        size_t emitted = 0;
+        while( !queue.empty() && emitted < limit ) {
+            const size_t n = queue.top().node;
+            queue.pop();
+            const Node cur = nodes[n];
+            if( cur.pos == N ) {
+                path.clear();
+                for(size_t i=n; nodes[i].parent >= 0; i=nodes[i].parent) {
+                    path.push_back(i);
+                }
+                buf.clear();
+                bool afterWord = false;
+                for(size_t i=path.size(); i-- > 0; ) {
+                    const Node& seg = nodes[path[i]];
+                    appendDigits(buf, digits, nodes[seg.parent].pos, seg.digitsEnd, afterWord);
+                    afterWord = seg.word != NO_WORD;
+                    if( afterWord ) appendWord(buf, index.word(seg.word));
+                }
+                ++emitted;
+                if( !sink(buf) ) return;
+                continue;
+            }
+            const Step& st = steps[cur.pos];
+            if( st.minStep == 0 ) {
+                Node child = { (int)n, N, N, NO_WORD, cur.score };
+                pushNode(nodes, queue, child, child.score);
+                continue;
+            }
+            for(int i=st.minStep; i<NR; ++i) {
+                const WordRange& r = m(i,st.minStart);
+                for(uint32_t k=r.first; k<r.first+r.count; ++k) {
+                    Node child = { (int)n, st.minStart, st.minStart+i, k, cur.score + wordScore(k, i) };
+                    pushNode(nodes, queue, child, child.score + best[child.pos]);
+                }
+            }
+            if( st.skipTo > 0 ) {
+                Node child = { (int)n, st.skipTo, st.skipTo, NO_WORD, cur.score };
+                pushNode(nodes, queue, child, child.score + best[child.pos]);
+            }
+        }
+    }
+    template<typename Node, typename Queue>
+    static void pushNode(std::vector<Node>& nodes, Queue& queue, const Node& node, double bound) {
+        typename Queue::value_type e = { bound, nodes.size() };
+        nodes.push_back(node);
+        queue.push(e);
+    }
+
+    static void appendWord(String& buf, const Char *word) {
+        if( !buf.empty() ) buf += SEP;
+        buf += word;
+    }
+    static void appendDigits(String& buf, const String& digits, int from, int to, bool afterWord) {
+        if( from == to ) return;
+        if( afterWord ) buf += SEP;
+        buf.append(digits, from, to-from);
+    }
+
+    // Upper-cases and encodes s[0..n), n up to 64, into word and digits.
+    // Bit i of others is set if s[i] is not a letter, and of newlines if it
+    // is '\n'; both are set from n on.
+    void encodeWindow(const char *s, size_t n, char *word, char *digits,
+                      uint64_t& others, uint64_t& newlines) const;
+    // a word of the reserved room of builder, if long enough
+    void addWord(DictIndexBuilder& builder, size_t pos, size_t len, size_t& numWords) const;
+    // the words of text[begin..end), whole lines, into builder
+    void encodeLines(const char *text, size_t begin, size_t end,
+                     DictIndexBuilder& builder, size_t& numWords) const;
+    // encodeLines() and sort, on a thread of processDic(). The bytes it
+    // allocates are added to *allocated, if set and counted.
+    void encodeChunk(const char *text, size_t begin, size_t end,
+                     DictIndexBuilder *builder, size_t *numWords,
+                     unsigned long long *allocated) const;
+
+    char a2d[256];   // upper case letter 2 digit, 0 for anything else
+    char keyStarts[26]; // first letter of every key after the one of 'A'
+    int numKeyStarts;
+    DictIndex index; // number 2 word, built from a dictionary or mapped from a file
+    std::vector<double> weights; // ranking weight per word in index, empty for all 1
+};
+
+} // namespace jz
+
+#endif
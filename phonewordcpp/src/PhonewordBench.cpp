@@ -0,0 +1,489 @@
+// Microbenchmarks of both phone word engines: the hash/DictIndex one of
+// PhoneNumberWord.h and the trie one of Spellophone.h, on a fixed set of
+// numbers against the same dictionary.
+//
+// Every benchmark prints one JSON object per line:
+//
+//     {"name":"cpp.combineWords","reps":5,"ops":8,"ns_per_op":...,
+//      "allocs_per_op":...,"results_per_sec":...}
+//
+// A rep runs the benchmark body once over its whole input; the fastest of
+// the reps is reported, after one warm up run, as it varies the least from
+// one run to the next. An op is what the name says (one
+// number, one word, one trie step...), results are what it produced
+// (words, matches, combinations...). Allocations are every malloc(),
+// calloc(), realloc() and operator new during the rep.
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <ctype.h>
+#include <time.h>
+#include <string>
+#include <vector>
+#include "PhoneNumberWord.h"
+#include "Spellophone.h"
+
+#ifndef PHONEWORD_BENCH_WORDS
+#define PHONEWORD_BENCH_WORDS "words"
+#endif
+
+// count the allocations by replacing malloc(), which operator new uses as
+// well; glibc exports its own implementation under __libc_ names.
+static unsigned long long numAllocs = 0;
+
+#ifdef __GLIBC__
+extern "C" {
+void* __libc_malloc(size_t size);
+void* __libc_calloc(size_t n, size_t size);
+void* __libc_realloc(void* p, size_t size);
+void __libc_free(void* p);
+
+void* malloc(size_t size) {
+    ++numAllocs;
+    return __libc_malloc(size);
+}
+void* calloc(size_t n, size_t size) {
+    ++numAllocs;
+    return __libc_calloc(n, size);
+}
+void* realloc(void* p, size_t size) {
+    ++numAllocs;
+    return __libc_realloc(p, size);
+}
+void free(void* p) {
+    __libc_free(p);
+}
+}
+#define COUNTS_ALLOCS 1
+#else
+#define COUNTS_ALLOCS 0
+#endif
+
+namespace jz{
+
+// TriestoreMain only takes 3 to 10 digits, so the numbers suit both engines
+static const char* const NUMBERS[] = {
+    "7292650782", "2255", "8663746937", "5550123", "3825687", "228",
+    "43556", "1800356937", "7272727272", "2272272272", 0
+};
+
+static long long nowNs() {
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return ts.tv_sec * 1000000000LL + ts.tv_nsec;
+}
+
+struct BenchResult {
+    unsigned long long ops, results;
+    BenchResult(): ops(0), results(0) {}
+};
+
+class Bench {
+public:
+    explicit Bench(const char *dictFile): dictFile(dictFile) {}
+    virtual ~Bench() {}
+    virtual const char* name() const = 0;
+    // untimed preparation, once before the reps
+    virtual bool setUp() { return true; }
+    virtual BenchResult run() = 0;
+    virtual void tearDown() {}
+protected:
+    const char *dictFile;
+};
+
+// The whole load of the C++ engine: reading the words and processDic().
+class LoadDictBench: public Bench {
+public:
+    explicit LoadDictBench(const char *f): Bench(f) {}
+    const char* name() const { return "cpp.loadDict"; }
+    BenchResult run() {
+        PhoneNumberWord pnw;
+        BenchResult r;
+        if( pnw.loadDict(dictFile) ) {
+            r.ops = 1;
+            r.results = pnw.index.numWords();
+        }
+        return r;
+    }
+};
+
+// Building the index from a dictionary already read.
+class ProcessDicBench: public Bench {
+public:
+    explicit ProcessDicBench(const char *f): Bench(f) {}
+    const char* name() const { return "cpp.processDic"; }
+    bool setUp() {
+        std::ifstream file(dictFile, std::ios::binary);
+        text.assign(std::istreambuf_iterator<char>(file), std::istreambuf_iterator<char>());
+        return file.is_open();
+    }
+    BenchResult run() {
+        BenchResult r;
+        if( pnw.processDic(text.data(), text.size()) ) {
+            r.ops = 1;
+            r.results = pnw.index.numWords();
+        }
+        return r;
+    }
+private:
+    PhoneNumberWord pnw;
+    std::string text;
+};
+
+// base of the benchmarks looking up NUMBERS in a loaded PhoneNumberWord
+class NumberBench: public Bench {
+public:
+    explicit NumberBench(const char *f): Bench(f) {}
+    bool setUp() { return pnw.loadDict(dictFile); }
+protected:
+    PhoneNumberWord pnw;
+};
+
+// Single key lookups of every substring of the numbers, as matchWord() used
+// to do them before fillMatrix() ran the automaton.
+class IndexFindBench: public NumberBench {
+public:
+    explicit IndexFindBench(const char *f): NumberBench(f) {}
+    const char* name() const { return "cpp.index.find"; }
+    BenchResult run() {
+        BenchResult r;
+        for(const char* const* n=NUMBERS; *n; ++n) {
+            const size_t N = strlen(*n);
+            for(size_t i=0; i<N; ++i) {
+                for(size_t len=PhoneNumberWord::MIN_WORD_LEN; i+len<=N; ++len) {
+                    r.results += pnw.index.find(*n + i, len).count;
+                    ++r.ops;
+                }
+            }
+        }
+        return r;
+    }
+};
+
+// All the matches of a number in one pass; an op is a number.
+class FillMatrixBench: public NumberBench {
+public:
+    explicit FillMatrixBench(const char *f): NumberBench(f) {}
+    const char* name() const { return "cpp.fillMatrix"; }
+    BenchResult run() {
+        BenchResult r;
+        for(const char* const* n=NUMBERS; *n; ++n) {
+            const String digits(*n);
+            const size_t N = digits.length();
+            WordRangeMatrix m(N+1, N);
+            pnw.fillMatrix(digits, m);
+            for(size_t i=0; i<=N; ++i) {
+                for(size_t j=0; j<N; ++j) {
+                    r.results += m(i,j).count;
+                }
+            }
+            ++r.ops;
+        }
+        return r;
+    }
+};
+
+// Enumerating the combinations of a number once its matches are known
+// (printWords(), which builds the suffix DAG and runs combineWords()).
+class CombineWordsBench: public NumberBench {
+public:
+    explicit CombineWordsBench(const char *f): NumberBench(f) {}
+    const char* name() const { return "cpp.combineWords"; }
+    bool setUp() {
+        if( !NumberBench::setUp() ) return false;
+        for(const char* const* n=NUMBERS; *n; ++n) {
+            const String digits(*n);
+            matrices.push_back(new WordRangeMatrix(digits.length()+1, digits.length()));
+            pnw.fillMatrix(digits, *matrices.back());
+        }
+        return true;
+    }
+    BenchResult run() {
+        BenchResult r;
+        for(size_t i=0; NUMBERS[i]; ++i) {
+            const String digits(NUMBERS[i]);
+            CountSink sink;
+            pnw.printWords(digits, *matrices[i], sink, scratch);
+            r.results += sink.count;
+            ++r.ops;
+        }
+        return r;
+    }
+    void tearDown() {
+        for(size_t i=0; i<matrices.size(); ++i) {
+            delete matrices[i];
+        }
+        matrices.clear();
+    }
+private:
+    std::vector<WordRangeMatrix*> matrices;  // Matrix can't be copied
+    PhoneNumberWord::Scratch scratch;
+};
+
+// the words TriestoreMain would insert: 2 to 10 characters, upper case
+static bool readTrieWords(const char *dictFile, std::vector<std::string>& words) {
+    FILE* file = fopen(dictFile, "r");
+    if( !file ) return false;
+    char line[PhoneNumberWord::MAX_LINE_LEN];
+    while( fgets(line, sizeof(line), file) ) {
+        size_t len = strcspn(line, "\n");
+        line[len] = 0;
+        if( len < MINIMUM_WORD || len > 10 ) continue;
+        for(size_t i=0; i<len; ++i) line[i] = toupper(line[i]);
+        words.push_back(line);
+    }
+    fclose(file);
+    return true;
+}
+
+// The whole load of the C engine, read_dict() into the letter trie.
+class ReadDictBench: public Bench {
+public:
+    explicit ReadDictBench(const char *f): Bench(f) {}
+    const char* name() const { return "c.read_dict"; }
+    BenchResult run() {
+        BenchResult r;
+        FILE* file = fopen(dictFile, "r");
+        if( !file ) return r;
+        Dictionary dict;
+        dict_init(&dict, DICT_TRIE, NULL);
+        r.results = read_dict(file, &dict, 10);
+        r.ops = 1;
+        dict_free(&dict);
+        fclose(file);
+        return r;
+    }
+};
+
+// trie_insert() of the words one at a time, in the order of the file.
+class TrieInsertBench: public Bench {
+public:
+    explicit TrieInsertBench(const char *f): Bench(f) {}
+    const char* name() const { return "c.trie_insert"; }
+    bool setUp() { return readTrieWords(dictFile, words); }
+    BenchResult run() {
+        BenchResult r;
+        Trie* trie = trie_create();
+        for(size_t i=0; i<words.size(); ++i) {
+            trie_insert(trie, words[i].c_str());
+        }
+        r.ops = words.size();
+        r.results = trie->node_count;
+        trie_destroy(trie);
+        return r;
+    }
+private:
+    std::vector<std::string> words;
+};
+
+// trie_follow() down the path of every word; an op is one step.
+class TrieFollowBench: public Bench {
+public:
+    explicit TrieFollowBench(const char *f): Bench(f), trie(0) {}
+    const char* name() const { return "c.trie_follow"; }
+    bool setUp() {
+        if( !readTrieWords(dictFile, words) ) return false;
+        trie = trie_create();
+        for(size_t i=0; i<words.size(); ++i) {
+            trie_insert(trie, words[i].c_str());
+        }
+        return true;
+    }
+    BenchResult run() {
+        BenchResult r;
+        for(size_t i=0; i<words.size(); ++i) {
+            TrieEntry* node = trie_root(trie);
+            for(const char* c=words[i].c_str(); *c && node; ++c) {
+                node = trie_follow(node, *c);
+                ++r.ops;
+            }
+            if( node && node->word ) ++r.results;
+        }
+        return r;
+    }
+    void tearDown() {
+        trie_destroy(trie);
+        trie = 0;
+    }
+private:
+    std::vector<std::string> words;
+    Trie* trie;
+};
+
+// base of the benchmarks running the C engine on NUMBERS
+class AppDataBench: public Bench {
+public:
+    explicit AppDataBench(const char *f): Bench(f) {}
+    bool setUp() {
+        dict_init(&dict, DICT_TRIE, NULL);
+        init_appdata(&appdata, &dict);
+        FILE* file = fopen(dictFile, "r");
+        if( !file ) return false;
+        read_dict(file, &dict, 10);
+        fclose(file);
+        return true;
+    }
+    void tearDown() {
+        appdata.number = 0;  // not ours
+        deinit_appdata(&appdata);
+        dict_free(&dict);
+    }
+protected:
+    Dictionary dict;
+    AppData appdata;
+};
+
+// The dynamic programming table of the numbers; an op is one column.
+class CreateColumnBench: public AppDataBench {
+public:
+    explicit CreateColumnBench(const char *f): AppDataBench(f) {}
+    const char* name() const { return "c.create_column"; }
+    BenchResult run() {
+        BenchResult r;
+        for(const char* const* n=NUMBERS; *n; ++n) {
+            const int length = strlen(*n);
+            appdata.number = (char*)*n;
+            arena_reset(&appdata.query_arena);
+            for(int pos=0; pos<length; ++pos) {
+                PartialSolution** column = create_column(&appdata, pos, length - pos);
+                for(int i=0; i<=length - pos; ++i) {
+                    r.results += column[i]->num_words;
+                }
+                ++r.ops;
+            }
+        }
+        arena_reset(&appdata.query_arena);
+        return r;
+    }
+};
+
+// enumerate_solutions() on tables built beforehand; an op is a number. The
+// solution set is emptied for every number, as it would be for a new run.
+class EnumerateSolutionsBench: public AppDataBench {
+public:
+    explicit EnumerateSolutionsBench(const char *f): AppDataBench(f) {}
+    const char* name() const { return "c.enumerate_solutions"; }
+    bool setUp() {
+        if( !AppDataBench::setUp() ) return false;
+        // the query arena is never reset, so all the tables stay valid
+        for(const char* const* n=NUMBERS; *n; ++n) {
+            const int length = strlen(*n);
+            appdata.number = (char*)*n;
+            PartialSolution*** table = (PartialSolution***)arena_alloc(
+                &appdata.query_arena, length * sizeof(PartialSolution**));
+            for(int pos=0; pos<length; ++pos) {
+                table[pos] = create_column(&appdata, pos, length - pos);
+            }
+            tables.push_back(table);
+        }
+        return true;
+    }
+    BenchResult run() {
+        BenchResult r;
+        for(size_t i=0; NUMBERS[i]; ++i) {
+            const int length = strlen(NUMBERS[i]);
+            std::vector<char> buffer(length * 2 + 1);
+            appdata.number = (char*)NUMBERS[i];
+            entry_set_free(&appdata.entries);
+            arena_init(&appdata.entries.strings, QUERY_ARENA_BLOCK);
+            enumerate_solutions(&appdata, tables[i], 0, length, &buffer[0], 0, 0);
+            r.results += appdata.entries.num_entries;
+            ++r.ops;
+        }
+        return r;
+    }
+private:
+    std::vector<PartialSolution***> tables;
+};
+
+static void report(const char *name, int reps, const BenchResult& r, long long ns,
+                   unsigned long long allocs) {
+    const double ops = r.ops > 0 ? (double)r.ops : 1.0;
+    printf("{\"name\":\"%s\",\"reps\":%d,\"ops\":%llu,\"ns_per_op\":%.1f,"
+           "\"allocs_per_op\":", name, reps, r.ops, ns / ops);
+    if( COUNTS_ALLOCS ) {
+        printf("%.4g", allocs / ops);
+    }else{
+        printf("null");
+    }
+    printf(",\"results_per_sec\":%.0f}\n", ns > 0 ? r.results * 1e9 / ns : 0.0);
+    fflush(stdout);
+}
+
+// Runs the benchmarks whose name contains filter (all with NULL).
+static int runBenchmarks(const char *dictFile, int reps, const char *filter) {
+    std::vector<Bench*> benches;
+    benches.push_back(new LoadDictBench(dictFile));
+    benches.push_back(new ProcessDicBench(dictFile));
+    benches.push_back(new IndexFindBench(dictFile));
+    benches.push_back(new FillMatrixBench(dictFile));
+    benches.push_back(new CombineWordsBench(dictFile));
+    benches.push_back(new ReadDictBench(dictFile));
+    benches.push_back(new TrieInsertBench(dictFile));
+    benches.push_back(new TrieFollowBench(dictFile));
+    benches.push_back(new CreateColumnBench(dictFile));
+    benches.push_back(new EnumerateSolutionsBench(dictFile));
+
+    int failed = 0;
+    for(size_t i=0; i<benches.size(); ++i) {
+        Bench& b = *benches[i];
+        if( filter && !strstr(b.name(), filter) ) continue;
+        if( !b.setUp() ) {
+            fprintf(stderr, "%s: could not read %s\n", b.name(), dictFile);
+            ++failed;
+            b.tearDown();
+            continue;
+        }
+        b.run(); // warm up
+        BenchResult best;
+        long long bestNs = -1;
+        unsigned long long bestAllocs = 0;
+        for(int rep=0; rep<reps; ++rep) {
+            const unsigned long long allocs0 = numAllocs;
+            const long long t0 = nowNs();
+            BenchResult r = b.run();
+            const long long ns = nowNs() - t0;
+            if( bestNs < 0 || ns < bestNs ) {
+                best = r;
+                bestNs = ns;
+                bestAllocs = numAllocs - allocs0;
+            }
+        }
+        b.tearDown();
+        report(b.name(), reps, best, bestNs, bestAllocs);
+    }
+    for(size_t i=0; i<benches.size(); ++i) {
+        delete benches[i];
+    }
+    return failed ? 1 : 0;
+}
+
+void print_bench_usage() {
+    printf("Usage: phoneword_bench [-d dict_file] [-r reps] [filter]\n");
+    printf("    -d dict_file  dictionary, default %s\n", PHONEWORD_BENCH_WORDS);
+    printf("    -r reps       timed runs of each benchmark, the fastest is reported (default 5)\n");
+    printf("    filter        only run the benchmarks whose name contains it\n");
+}
+
+} // namespace jz
+
+int main(int argc, const char* argv[])
+{
+    const char *dictFile = PHONEWORD_BENCH_WORDS;
+    const char *filter = NULL;
+    int reps = 5;
+    for(int i=1; i<argc; ++i) {
+        if( strcmp(argv[i], "-d") == 0 && i+1 < argc ) {
+            dictFile = argv[++i];
+        }else if( strcmp(argv[i], "-r") == 0 && i+1 < argc ) {
+            reps = atoi(argv[++i]);
+            if( reps < 1 ) reps = 1;
+        }else if( argv[i][0] == '-' ) {
+            jz::print_bench_usage();
+            return 1;
+        }else{
+            filter = argv[i];
+        }
+    }
+    return jz::runBenchmarks(dictFile, reps, filter);
+}
@@ -0,0 +1,153 @@
+// Small client for `phonewordcpp --serve <socket>`.
+// Sends every number to the server and prints the replies in the same
+// format as the one-shot CLI.
+#include <string.h>
+#include <stdio.h>
+#include <errno.h>
+#include <unistd.h>
+#include <sys/socket.h>
+#include <sys/un.h>
+#include <iostream>
+#include <string>
+
+namespace jz{
+
+const char *DEFAULT_SOCKET = "/tmp/phoneword.sock";
+
+void print_usage()
+{
+    const char* program = "phonewordclient";
+    printf("Usage: %s [OPTIONS] [numbers]\n", program);
+    printf("Query a phonewordcpp server for words hidden inside phone numbers (separated by comma).\n\n");
+    printf("  If numbers are not given, they are read from stdin, one or more per line.\n");
+    printf(" -s <socket> Server socket (Default: %s)\n", DEFAULT_SOCKET);
+    printf("\nExample:\n");
+    printf(" phonewordcpp --serve %s &\n", DEFAULT_SOCKET);
+    printf(" %s 2255.63,7292650782\n", program);
+}
+
+class PhoneWordClient {
+public:
+    PhoneWordClient(): fd(-1), pos(0), len(0) {}
+    ~PhoneWordClient() {
+        if( fd >= 0 ) close(fd);
+    }
+
+    bool connect(const char *socketPath) {
+        struct sockaddr_un addr;
+        memset(&addr, 0, sizeof(addr));
+        addr.sun_family = AF_UNIX;
+        if( strlen(socketPath) >= sizeof(addr.sun_path) ) return false;
+        strcpy(addr.sun_path, socketPath);
+        fd = socket(AF_UNIX, SOCK_STREAM, 0);
+        return fd >= 0 && ::connect(fd, (struct sockaddr*)&addr, sizeof(addr)) == 0;
+    }
+
+    // send one number and copy the reply (up to the empty line) to stdout
+    bool query(const std::string& num) {
+        std::string req = num + "\n";
+        const char *p = req.data();
+        size_t left = req.length();
+        while( left > 0 ) {
+            ssize_t n = send(fd, p, left, MSG_NOSIGNAL);
+            if( n < 0 && errno == EINTR ) continue;
+            if( n <= 0 ) return false;
+            p += n;
+            left -= n;
+        }
+        std::string line;
+        while( readLine(line) ) {
+            if( line.empty() ) return true;
+            std::cout << line << '\n';
+        }
+        return false;
+    }
+
+private:
+    bool readLine(std::string& line) {
+        line.clear();
+        for(;;) {
+            if( pos == len ) {
+                ssize_t n = read(fd, buf, sizeof(buf));
+                if( n < 0 && errno == EINTR ) continue;
+                if( n <= 0 ) return false;
+                pos = 0;
+                len = n;
+            }
+            char *nl = (char*)memchr(buf + pos, '\n', len - pos);
+            if( nl == NULL ) {
+                line.append(buf + pos, len - pos);
+                pos = len;
+                continue;
+            }
+            line.append(buf + pos, nl - (buf + pos));
+            pos = nl - buf + 1;
+            return true;
+        }
+    }
+
+    int fd;
+    char buf[4096];
+    size_t pos, len;
+};
+
+// send every comma separated number in the list
+bool queryList(PhoneWordClient& client, const std::string& numbers)
+{
+    const char DEL = ',';
+    for(size_t currPos = 0; currPos<numbers.length(); ++currPos) {
+        size_t pos = numbers.find_first_of(DEL, currPos);
+        if( pos == std::string::npos ) {
+            pos = numbers.length();
+        }
+        // the server does not answer empty requests
+        if( pos > currPos && !client.query(numbers.substr(currPos, pos-currPos)) ) return false;
+        currPos = pos;
+    }
+    return true;
+}
+
+int run(int argc, const char* argv[])
+{
+    const char *socketPath = DEFAULT_SOCKET;
+    std::string number;
+    for(int i=1; i<argc; ++i) {
+        if( 0 == strcmp(argv[i], "-s") ) {
+            ++i;
+            socketPath = argv[i];
+        }else if( 0 == strcmp(argv[i], "-h")
+                  || 0 == strcmp(argv[i], "-?")
+                  || 0 == strcmp(argv[i], "--help")) {
+            print_usage();
+            return 0;
+        }else{
+            number = argv[i];
+        }
+    }
+
+    PhoneWordClient client;
+    if( !client.connect(socketPath) ) {
+        printf("Failed to connect to %s: %s\n", socketPath, strerror(errno));
+        return -1;
+    }
+    bool ok = true;
+    if( !number.empty() ) {
+        ok = queryList(client, number);
+    }else{
+        std::string s;
+        while( ok && getline(std::cin, s) ) {
+            ok = queryList(client, s);
+        }
+    }
+    if( !ok ) {
+        printf("Connection to server lost!\n");
+        return -1;
+    }
+    return 0;
+}
+} // namespace jz
+
+int main(int argc, const char* argv[])
+{
+    return jz::run(argc, argv);
+}
@@ -0,0 +1,16 @@
+#ifndef PHONEWORDTEXT_H
+#define PHONEWORDTEXT_H
+
+// Literals and the standard output stream of the Char type in
+// PhoneNumberWord.h. Only for the library's own sources and the front ends:
+// the short names would clash in the code of users of the installed headers.
+
+#ifdef _UNICODE
+#define _T(text) L##text
+#define Cout ::std::wcout
+#else
+#define _T(text) text
+#define Cout std::cout
+#endif
+
+#endif
@@ -0,0 +1,1037 @@
+/****************************************************************************
+ * spellophone
+ *
+ * Algorithm to check phone numbers for words.
+ * by steve.hanov@mail.com
+ *
+ * */
+
+#include <assert.h>
+#include <ctype.h>
+#include <memory.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include "Spellophone.h"
+
+/*
+ * add a name to a linked list of dictionary files, and returns new head.
+ *
+ * example: list = dict_file_list_add(list, "words.txt");
+ */
+DictFileList*
+dict_file_list_add( DictFileList* head, const char* str )
+{
+	DictFileList* node;
+
+	node = (DictFileList*)malloc(sizeof(DictFileList));
+	node->str = strdup(str);
+	node->next = head;
+
+	return node;
+}
+
+/* 
+ * Free a linked list of dictionary files.
+ */
+void
+dict_file_list_free( DictFileList* head )
+{
+	DictFileList* current = head;
+	DictFileList* next = 0;
+
+	while ( current ) {
+		next = current->next;
+		free(current->str);
+		free(current);
+		current = next;
+	}
+}
+
+/*
+ * FNV-1a hash of a string.
+ */
+static unsigned int hash_string( const char* str )
+{
+	unsigned int hash = 2166136261u;
+
+	while ( *str ) {
+		hash = (hash ^ (unsigned char)*str++) * 16777619u;
+	}
+
+	return hash;
+}
+
+/*
+ * Double the hash table of the set and put the entries back in.
+ */
+int entry_set_grow( EntrySet* set )
+{
+	int num_slots = set->num_slots ? set->num_slots * 2 : 1024;
+	int mask = num_slots - 1;
+	int* slots;
+	int i;
+
+	slots = (int*)calloc(num_slots, sizeof(int));
+	if ( 0 == slots ) {
+		return -1;
+	}
+
+	for ( i = 0; i < set->num_entries; ++i ) {
+		int slot = set->entries[i].hash & mask;
+		while ( slots[slot] ) {
+			slot = (slot + 1) & mask;
+		}
+		slots[slot] = i + 1;
+	}
+
+	free(set->slots);
+	set->slots = slots;
+	set->num_slots = num_slots;
+	return 0;
+}
+
+/*
+ * Add a solution to the set, unless it is already there.
+ *
+ * Returns 1 if the solution was added, 0 if it was a duplicate (the score
+ * of the first one is kept) or -1 if out of memory.
+ */
+int entry_set_add( EntrySet* set, const char* str, int score )
+{
+	unsigned int hash = hash_string(str);
+	SolutionEntry* entry;
+	int slot;
+
+	if ( 2 * (set->num_entries + 1) > set->num_slots ) {
+		if ( 0 != entry_set_grow(set) ) {
+			return -1;
+		}
+	}
+
+	for ( slot = hash & (set->num_slots - 1); set->slots[slot]; 
+		slot = (slot + 1) & (set->num_slots - 1) ) {
+		entry = &set->entries[set->slots[slot] - 1];
+		if ( entry->hash == hash && 0 == strcmp(entry->str, str) ) {
+			return 0;
+		}
+	}
+
+	if ( set->num_entries == set->max_entries ) {
+		int max_entries = set->max_entries ? set->max_entries * 2 : 1024;
+		SolutionEntry* entries = (SolutionEntry*)realloc(set->entries, 
+			max_entries * sizeof(SolutionEntry));
+		if ( 0 == entries ) {
+			return -1;
+		}
+		set->entries = entries;
+		set->max_entries = max_entries;
+	}
+
+	entry = &set->entries[set->num_entries];
+	entry->str = (char*)arena_alloc(&set->strings, strlen(str) + 1);
+	if ( 0 == entry->str ) {
+		return -1;
+	}
+	strcpy(entry->str, str);
+	entry->score = score;
+	entry->hash = hash;
+	set->slots[slot] = ++set->num_entries;
+	return 1;
+}
+
+/*
+ * Empty the set, keeping its memory for the next solutions.
+ */
+void entry_set_clear( EntrySet* set )
+{
+	if ( set->slots ) {
+		memset(set->slots, 0, set->num_slots * sizeof(int));
+	}
+	set->num_entries = 0;
+	arena_reset(&set->strings);
+}
+
+void entry_set_free( EntrySet* set )
+{
+	arena_free(&set->strings);
+	free(set->entries);
+	free(set->slots);
+	set->entries = 0;
+	set->num_entries = set->max_entries = 0;
+	set->slots = 0;
+	set->num_slots = 0;
+}
+
+/*
+ * Purpose:
+ *      Tries the given list of files in order until it opens one,
+ *      then returns the FILE* of the open file.
+ */
+FILE* open_dict_file( const char* names[] ) 
+{
+	int i = 0;
+	
+	while ( names[i] ) {
+		FILE* fd = 0;
+		fd = fopen( names[i], "r" );
+		if ( fd ) {
+			return fd;
+		}
+
+		++i;
+	}
+
+	return 0;
+}
+
+/* The letters of a phone keypad. */
+static const char* standard_keymap[10] = 
+{
+	"", "", "ABC", "DEF", "GHI", "JKL", "MNO", "PQRS", "TUV", "WXYZ"
+};
+
+/*
+ * Create an empty dictionary of the given kind (DICT_TRIE, 
+ * DICT_COMPACT_TRIE or DICT_DIGIT_TRIE) for a keypad, where keymap[d] 
+ * lists the letters on digit d, or for a phone keypad if keymap is 0. 
+ * The keymap strings are not copied.
+ */
+void
+dict_init( Dictionary* dict, int kind, const char* keymap[10] )
+{
+	memset(dict, 0, sizeof(*dict));
+	memcpy(dict->keymap, keymap ? keymap : standard_keymap, 
+		sizeof(dict->keymap));
+
+	if ( DICT_DIGIT_TRIE == kind ) {
+		dict->dtrie = dtrie_create(dict->keymap);
+	} else if ( DICT_COMPACT_TRIE == kind ) {
+		dict->ctrie = ctrie_create();
+	} else {
+		dict->trie = trie_create();
+	}
+}
+
+void
+dict_free( Dictionary* dict )
+{
+	trie_destroy(dict->trie);
+	ctrie_destroy(dict->ctrie);
+	dtrie_destroy(dict->dtrie);
+	memset(dict, 0, sizeof(*dict));
+}
+
+int
+dict_node_count( const Dictionary* dict )
+{
+	if ( dict->dtrie ) {
+		return dict->dtrie->node_count;
+	}
+	if ( dict->ctrie ) {
+		return dict->ctrie->node_count;
+	}
+	return dict->trie->node_count;
+}
+
+long
+dict_memory( const Dictionary* dict )
+{
+	if ( dict->dtrie ) {
+		return dtrie_memory(dict->dtrie);
+	}
+	if ( dict->ctrie ) {
+		return ctrie_memory(dict->ctrie);
+	}
+	return trie_memory(dict->trie);
+}
+
+/*
+ * The trie is either the pointer based TrieEntry one or, with -c, the
+ * CompactTrie, or with -t the DigitTrie. These wrap the operations the 
+ * algorithm needs for all of them; nodes are passed around as opaque 
+ * pointers. follow_node() is for the letter tries only, the digit trie 
+ * is followed directly by digit.
+ */
+int
+insert_word( Dictionary* dict, const char* word )
+{
+	if ( dict->dtrie ) {
+		dtrie_insert(dict->dtrie, word);
+	} else if ( dict->ctrie ) {
+		ctrie_insert(dict->ctrie, word);
+	} else {
+		return trie_insert(dict->trie, word);
+	}
+	return 0;
+}
+
+const void*
+root_node( const Dictionary* dict )
+{
+	if ( dict->dtrie ) {
+		return dtrie_root(dict->dtrie);
+	}
+	if ( dict->ctrie ) {
+		return ctrie_root(dict->ctrie);
+	}
+	return trie_root(dict->trie);
+}
+
+const void*
+follow_node( const Dictionary* dict, const void* node, char c )
+{
+	if ( dict->ctrie ) {
+		return ctrie_follow(dict->ctrie, (const CompactTrieNode*)node, c);
+	}
+	return trie_follow((TrieEntry*)node, c);
+}
+
+int
+is_word_node( const Dictionary* dict, const void* node )
+{
+	if ( dict->dtrie ) {
+		return ((const DigitTrieNode*)node)->num_words > 0;
+	}
+	if ( dict->ctrie ) {
+		return ((const CompactTrieNode*)node)->end;
+	}
+	return ((const TrieEntry*)node)->word != 0;
+}
+
+/*
+ * Number of words ending at a node.
+ */
+int
+node_word_count( const Dictionary* dict, const void* node )
+{
+	if ( dict->dtrie ) {
+		return ((const DigitTrieNode*)node)->num_words;
+	}
+	return is_word_node(dict, node) ? 1 : 0;
+}
+
+/*
+ * Copies the index'th word ending at a node into buffer and returns its
+ * length, or 0 if there is no such word. A node of a letter trie spells 
+ * only one word, a node of the digit trie may hold several.
+ */
+int
+get_node_word( const Dictionary* dict, const void* node, int index, 
+	char* buffer, int buffer_len )
+{
+	if ( dict->dtrie ) {
+		const DigitTrieNode* dnode = (const DigitTrieNode*)node;
+		int len = 0;
+		if ( index >= dnode->num_words ) {
+			return 0;
+		}
+		len = strlen(dnode->words[index]);
+		if ( len >= buffer_len ) {
+			len = buffer_len - 1;
+		}
+		memcpy(buffer, dnode->words[index], len);
+		buffer[len] = 0;
+		return len;
+	}
+	if ( index > 0 ) {
+		return 0;
+	}
+	if ( dict->ctrie ) {
+		return ctrie_get_word(dict->ctrie, (const CompactTrieNode*)node,
+			buffer, buffer_len);
+	}
+	return trie_get_word(dict->trie, (const TrieEntry*)node, buffer, 
+		buffer_len);
+}
+
+/*
+ * Read all of a file into a '\0' terminated buffer. Returns NULL on error.
+ */
+static char* read_file( FILE* file, long* size )
+{
+	char* data = 0;
+	long len = 0;
+	long alloc = 0;
+	size_t n;
+
+	do {
+		if ( alloc - len < 4096 ) {
+			char* new_data;
+			alloc = alloc ? alloc * 2 : 64 * 1024;
+			new_data = (char*)realloc(data, alloc + 1);
+			if ( 0 == new_data ) {
+				free(data);
+				return 0;
+			}
+			data = new_data;
+		}
+		n = fread(data + len, 1, alloc - len, file);
+		len += n;
+	} while ( n > 0 );
+
+	if ( ferror(file) ) {
+		free(data);
+		return 0;
+	}
+
+	data[len] = 0;
+	*size = len;
+	return data;
+}
+
+static int compare_words( const void* a, const void* b )
+{
+	return strcmp(*(const char**)a, *(const char**)b);
+}
+
+/*
+ * Read a dictionary file into the trie structure.
+ *
+ * The whole file is read and split into words in place. The letter trie
+ * is then built in one pass from the sorted words; the other tries take 
+ * them one at a time in the order of the file.
+ *
+ * Parameters:
+ *      file: Dictionary file containing words separated by newlines.
+ *      dict: the words go into its trie
+ *      num_chars: words greater than this length are skipped. 0 (or 
+ *                 less) keeps words of any length, for a dictionary 
+ *                 searched with numbers of different lengths.
+ *
+ * Returns the number of words read, or -1 if out of memory.
+ */
+int read_dict( FILE* file, Dictionary* dict, int num_chars )
+{
+	char* data;
+	char* line;
+	long size = 0;
+	const char** words = 0;
+	int max_words = 0;
+	int num = 0;
+	int sorted = 1;
+	int i;
+
+	data = read_file(file, &size);
+	if ( 0 == data ) {
+		return 0;
+	}
+
+	for ( line = data; line < data + size; ) {
+		char* eol = (char*)memchr(line, '\n', data + size - line);
+		char* ch;
+		int len;
+
+		if ( 0 == eol ) {
+			eol = data + size;
+		}
+		*eol = 0;
+		len = eol - line;
+
+		// filter word
+		// disallow words over num_chars, if given
+		if ( len >= MINIMUM_WORD && ( num_chars <= 0 || len <= num_chars ) ) {
+			for ( ch = line; *ch; ++ch ) {
+				*ch = toupper( *ch );
+			}
+
+			if ( num == max_words ) {
+				const char** new_words;
+				max_words = max_words ? max_words * 2 : 1024;
+				new_words = (const char**)realloc(words, 
+					max_words * sizeof(const char*));
+				if ( 0 == new_words ) {
+					free(words);
+					free(data);
+					return -1;
+				}
+				words = new_words;
+			}
+			if ( num > 0 && strcmp(words[num - 1], line) > 0 ) {
+				sorted = 0;
+			}
+			words[num++] = line;
+		}
+
+		line = eol + 1;
+	}
+
+	if ( dict->dtrie || dict->ctrie ) {
+		for ( i = 0; i < num; ++i ) {
+			insert_word(dict, words[i]);
+		}
+	} else {
+		if ( !sorted ) {
+			qsort(words, num, sizeof(const char*), compare_words);
+		}
+		if ( trie_insert_sorted(dict->trie, words, num) < 0 ) {
+			num = -1;
+		}
+	}
+
+	free(words);
+	free(data);
+	return num;
+}
+
+/*
+ * Sort the entries of the set by score, lowest first, into sorted. Entries
+ * with the same score stay in the order they were found.
+ *
+ * Scores are small non-negative numbers, so this is an LSD radix sort on
+ * their bytes, skipping the bytes that are the same for every entry.
+ */
+void sort_entries( const EntrySet* set, SolutionEntry** sorted )
+{
+	SolutionEntry** from = sorted;
+	SolutionEntry** to;
+	int count[256];
+	int shift;
+	int i;
+
+	if ( 0 == set->num_entries ) {
+		return;
+	}
+
+	for ( i = 0; i < set->num_entries; ++i ) {
+		sorted[i] = &set->entries[i];
+	}
+
+	to = (SolutionEntry**)malloc(set->num_entries * sizeof(SolutionEntry*));
+
+	for ( shift = 0; shift < 32; shift += 8 ) {
+		int pos = 0;
+		SolutionEntry** swap;
+
+		memset(count, 0, sizeof(count));
+		for ( i = 0; i < set->num_entries; ++i ) {
+			count[((unsigned)from[i]->score >> shift) & 0xff]++;
+		}
+		if ( count[((unsigned)from[0]->score >> shift) & 0xff] == 
+			set->num_entries ) {
+			continue;
+		}
+
+		for ( i = 0; i < 256; ++i ) {
+			int n = count[i];
+			count[i] = pos;
+			pos += n;
+		}
+		for ( i = 0; i < set->num_entries; ++i ) {
+			to[count[((unsigned)from[i]->score >> shift) & 0xff]++] = from[i];
+		}
+
+		swap = from;
+		from = to;
+		to = swap;
+	}
+
+	/* an odd number of passes leaves the result in the scratch array */
+	if ( from != sorted ) {
+		memcpy(sorted, from, set->num_entries * sizeof(SolutionEntry*));
+		to = from;
+	}
+
+	free(to);
+}
+
+/*
+ * True if entry a ranks below entry b: a lower score, or the same score
+ * and found earlier (so it would be shown after b).
+ */
+static int entry_worse( const SolutionEntry* a, const SolutionEntry* b )
+{
+	return a->score < b->score || ( a->score == b->score && a < b );
+}
+
+/*
+ * Move the entry at heap[i] down to its place in a heap of n entries
+ * with the worst one on top.
+ */
+static void heap_sift_down( SolutionEntry** heap, int n, int i )
+{
+	for ( ;; ) {
+		int child = 2 * i + 1;
+		SolutionEntry* tmp;
+
+		if ( child >= n ) {
+			break;
+		}
+		if ( child + 1 < n && entry_worse(heap[child + 1], heap[child]) ) {
+			child++;
+		}
+		if ( !entry_worse(heap[child], heap[i]) ) {
+			break;
+		}
+		tmp = heap[i];
+		heap[i] = heap[child];
+		heap[child] = tmp;
+		i = child;
+	}
+}
+
+/*
+ * Keep the best limit entries of the set in a heap and return them in
+ * sorted, in the same order sort_entries() would put them. Returns how
+ * many there are.
+ */
+int select_best_entries( const EntrySet* set, int limit, 
+	SolutionEntry** sorted )
+{
+	int n = 0;
+	int i;
+
+	for ( i = 0; i < set->num_entries; ++i ) {
+		SolutionEntry* entry = &set->entries[i];
+
+		if ( n < limit ) {
+			int j = n++;
+			/* sift up */
+			sorted[j] = entry;
+			while ( j > 0 && entry_worse(sorted[j], sorted[(j - 1) / 2]) ) {
+				SolutionEntry* tmp = sorted[j];
+				sorted[j] = sorted[(j - 1) / 2];
+				sorted[(j - 1) / 2] = tmp;
+				j = (j - 1) / 2;
+			}
+		} else if ( entry_worse(sorted[0], entry) ) {
+			sorted[0] = entry;
+			heap_sift_down(sorted, n, 0);
+		}
+	}
+
+	/* 
+	 * Heap sort: swapping the worst entry to the end leaves the array
+	 * best first, so reverse it to get lowest first.
+	 */
+	for ( i = n - 1; i > 0; --i ) {
+		SolutionEntry* tmp = sorted[0];
+		sorted[0] = sorted[i];
+		sorted[i] = tmp;
+		heap_sift_down(sorted, i, 0);
+	}
+	for ( i = 0; i < n / 2; ++i ) {
+		SolutionEntry* tmp = sorted[i];
+		sorted[i] = sorted[n - 1 - i];
+		sorted[n - 1 - i] = tmp;
+	}
+
+	return n;
+}
+/*
+ * Copy the words of a square of the grid out of the trie into its words 
+ * array. They all have length characters.
+ */
+void
+collect_words( AppData* appdata, PartialSolution* solution, int length )
+{
+	Arena* arena = &appdata->query_arena;
+	const Dictionary* dict = appdata->dict;
+	TrieContext* context;
+	int num = 0;
+
+	for ( context = solution->completed_words; context; 
+		context = context->next ) {
+		num += node_word_count(dict, context->node);
+	}
+	if ( 0 == num ) {
+		return;
+	}
+
+	solution->words = (const char**)arena_alloc(arena, num * sizeof(char*));
+	for ( context = solution->completed_words; context; 
+		context = context->next ) {
+		int w;
+		int count = node_word_count(dict, context->node);
+		for ( w = 0; w < count; ++w ) {
+			char* word = (char*)arena_alloc(arena, length + 1);
+			get_node_word(dict, context->node, w, word, length + 1);
+			solution->words[solution->num_words++] = word;
+		}
+	}
+}
+
+/*
+ * Create a single column of the dynamic programming grid.
+ *
+ * For example, create_column(appdata,  2, 7) would return a 1-D
+ * array of 7 partial solutions containing all of the completed words
+ * beginning at digit 2 of the phone nummber.
+ */
+PartialSolution** 
+create_column( AppData* appdata, int starting_pos, int max_length )
+{
+	/* Create one column of the dynamic programming table described in 
+		quick_algorithm(..)
+	*/
+
+	const Dictionary* dict = appdata->dict;
+	PartialSolution** column = 0;
+	PartialSolution* previous_solution = 0;
+	int length = 0;
+
+	/* 
+	 * Allocate space for the column of solutions. There is one square for
+	 * each possible length, from 0 to max_length. 
+	 * Note that it includes 0, so it is max_length + 1
+	*/
+
+	column = (PartialSolution**)arena_calloc( &appdata->query_arena,
+		(max_length+1) * sizeof(PartialSolution*) );
+	
+	/* for every possible length, */ 
+	for ( length = 0; length <= max_length; ++length ) {
+
+		const char* const* KEYPAD = &dict->keymap[0];
+
+		/* initialize entry */
+		column[length] = (PartialSolution*)arena_calloc( 
+			&appdata->query_arena, sizeof(PartialSolution) );
+
+		/* if this is the first entry in the row we have nothing to build 
+		on, so just initialize some data */
+		if (0 == length ) {
+			column[length]->partial_words = (TrieContext*)arena_alloc( 
+				&appdata->query_arena, sizeof(TrieContext) );
+			column[length]->partial_words->node = root_node(dict);
+			column[length]->partial_words->next = 0;
+		} else {
+			/* not first entry -- build on previous. */
+			TrieContext* current_context = 0;
+
+			current_context = column[length-1]->partial_words;
+
+			/* For every partially completed word in the previous solution, */
+			while ( current_context ) {
+
+				/* Try adding all letters for this digit of the phone number,
+				 * and see if it results in a partial or complete word that
+				 * we can then add to this solution. 
+				 **/
+					  
+				const void* new_node = 0;
+				const char* keys = 0;
+				int key_len = 0;
+				int i = 0;
+				char digit = appdata->number[starting_pos + length - 1];
+				
+				/* Get the letters corresponding to the current digit. 
+				 * The digit trie has all of them under one child. */
+				keys = KEYPAD[digit - '0'];
+				key_len = dict->dtrie ? 1 : strlen(keys);
+
+				/* For each letter (eg. "PQRS") */
+				for ( i = 0; i < key_len; ++i ) {
+					/* Traverse the trie. */
+					if ( dict->dtrie ) {
+						new_node = dtrie_follow(
+							(const DigitTrieNode*)current_context->node, digit);
+					} else {
+						new_node = follow_node(dict, current_context->node, 
+							keys[i] );
+					}
+
+					/* If adding this letter results in a valid word, */
+					if ( new_node ) {
+						/* 
+						 * Create a new context and add it to this partial 
+						 * solution. 
+						 */
+						TrieContext* new_context = 0;
+						new_context = (TrieContext*)arena_alloc(
+							&appdata->query_arena, sizeof(TrieContext));
+						new_context->next = column[length]->partial_words;
+						new_context->node = new_node;
+						column[length]->partial_words = new_context;
+
+						/* If adding the letter resulted in a completed word, */
+						if ( is_word_node(dict, new_context->node) ) {
+							/* Add it to the list of completed words for this
+							 * grid square.
+							 */
+							TrieContext* completed_context = 0;
+							completed_context = (TrieContext*)arena_alloc(
+								&appdata->query_arena, sizeof(TrieContext));
+							completed_context->next = column[length]->completed_words;
+							completed_context->node = new_node;
+							column[length]->completed_words = completed_context;
+						} /* if ended word */
+					} /* if valid word */
+				} /* key loop */
+
+				current_context = current_context->next;
+			} /* while contexts left to follow */
+		} /* if not first entry */
+
+		collect_words(appdata, column[length], length);
+	} /* for each row */
+
+	return column;
+}
+
+/*
+ * Given an array of partial solutions (as described above) it will
+ * efficiently enumerate all combinations of completed words and add them
+ * to the appdata entry tree.
+ *
+ * Note this is a recursive algorithm.
+		
+ *
+ * Parameters:
+ * 	appdata - solution entries are added to the root stored here.
+ * 	table - Array of columns of partial solutions.
+ * 	starting_pos: First digit of appdata->number to examine.
+ * 	length: Maximum number of digits in appdata->number left.
+ * 	buffer: Holds the solution being built; its first prefix_len 
+ * 	        characters are prepended to all enumerated solutions. The
+ * 	        whole recursion shares it, so it has to have room for
+ * 	        strlen(appdata->number) * 2 + 1 characters.
+ * 	prefix_len: Length of the prefix in buffer. In the initial call, 
+ * 	            pass 0. Used for recursion.
+ * 	score: Score that is added to the calculated score of all enumerated
+ * 	       solutions. Initially, pass 0. Used for recursion.
+ *
+ * Returns:
+ *    Number of solutions enumerated.
+ */
+int
+enumerate_solutions(AppData* appdata, PartialSolution*** table, 
+					int starting_pos, int length, char* buffer, int prefix_len,
+					int score )
+{
+	int i = 0;
+	int num_solutions = 0;
+	int buffer_start_pos = 0;
+
+	if ( length < MINIMUM_WORD ) {
+		/* Stop if we are out of digits. */
+		return 0;
+	}
+
+	/* The solution so far ends at prefix_len; everything after it is
+	 * ours to change. */
+	buffer[prefix_len] = 0;
+	buffer_start_pos = prefix_len;
+	
+	/* If this is not the first character, append a '-'. */
+	if ( starting_pos > 0 && buffer_start_pos > 0 && 
+	     buffer[buffer_start_pos-1] != '-') {
+		buffer[buffer_start_pos++] = '-';
+		buffer[buffer_start_pos] = 0;
+	}
+	
+	/* Starting with the longest words, loop through the partial solutions. */
+	for ( i = length; i >= MINIMUM_WORD; --i ) {
+		PartialSolution** column = 0;
+		int w = 0;
+		column = table[starting_pos];
+
+		/* 
+		 * column[i] now contains all of the completed words that begin on
+		 * starting_pos and are exactly i characters long.
+		 */
+		
+		/* For each word in the list of completed words, */
+		for ( w = 0; w < column[i]->num_words; ++w ) {
+			int word_len = i;
+			int solutions_added = 0;
+
+			/* Append it to the buffer. */
+			memcpy(&buffer[buffer_start_pos], column[i]->words[w], word_len);
+
+			/* 
+			 * Recurse, adjusting the starting position and length
+			 * to account for the added word. This will enumerate
+			 * all solutions that begin with this word. (Plus what
+			 * we have from previous recursions)
+			 */
+			solutions_added += enumerate_solutions(appdata, table, 
+				starting_pos + i, length - i, buffer, 
+				buffer_start_pos + word_len, i*i);
+
+			/* 
+			 * If the numbers after this word do not form any more
+			 * words,
+			 */
+			if ( solutions_added == 0 ) {
+
+				/*
+				 * Add on the remainder of the phone number as digits,
+				 * after a dash if necessary, then output the solution.
+				 */
+				char* end = &buffer[buffer_start_pos + word_len];
+				if ( 0 != appdata->number[starting_pos + i] ) {
+					*end++ = '-';
+					strcpy(end, &appdata->number[starting_pos + i]);
+				} else {
+					*end = 0;
+				}
+
+				if ( entry_set_add(&appdata->entries, buffer, 
+					score + i*i) > 0 ) {
+					solutions_added++;
+				}
+			}
+		
+			num_solutions += solutions_added;
+
+			/* 
+			 * Remove the word we added from the end of the buffer
+			 * and go on to the next one.
+			 */
+			buffer[buffer_start_pos] = 0;
+		}
+		
+		/*
+		 * We have now enumerated all solutions beginning at the
+		 * given starting position. We will now recurse and
+		 * try all words starting at the next digit.
+		 *
+		 * If there are more digits to try,
+		 */
+		if ( 0 != appdata->number[starting_pos + i] ) {
+			/*
+			 * But first, we have to do some magic to get the 
+			 * dashes right.
+			 */
+			int my_start_pos = buffer_start_pos;
+			int deleted_dash = 0;
+			if ( (my_start_pos > 1) && (buffer[my_start_pos - 1] == '-') 
+				&& (buffer[my_start_pos - 2] >= '0') 
+				&& (buffer[my_start_pos - 2] <= '9')) {
+				my_start_pos--;
+				deleted_dash = 1;
+			}
+			
+			/*
+			 * Add the number corresponding to this starting position,
+			 * since we have already enumerated all words where it is 
+			 * a letter, add the number.
+			 */
+			buffer[my_start_pos] = appdata->number[starting_pos];
+			buffer[my_start_pos+1] = 0;
+			num_solutions += enumerate_solutions(appdata, table, 
+				starting_pos + 1, i, buffer, my_start_pos + 1, score);
+			buffer[buffer_start_pos] = 0;
+			if ( deleted_dash ) {
+				buffer[my_start_pos] = '-';
+			}
+		}
+
+		/* 
+		 * buffer is now back to the same state is was at the beginning of 
+		 * the loop
+		 */
+	}
+
+	return num_solutions;
+}
+
+
+/* 
+ * Dynamic programming algorithm: Build a 2-D array. X values (columns)
+ * are the position of the first character of the word. Y values (rows) are the
+ * length of the word. Each table entry is a context, which contains all of the
+ * partial and finished words with the specified starting letter and length.
+ *
+ * Example: 
+ *     Partial solution at coordinates (2, 5) contains all of the
+ *     partially and completed words that begin at the second digit of the
+ *     phone number and are exactly five digits long.
+ */
+int quick_algorithm(AppData* appdata)
+{
+
+	PartialSolution*** table = 0;
+	char* buffer = 0;
+	int length = 0;
+	int starting_pos = 0;
+	int num_solutions = 0;
+
+	/* calculate number of rows */
+	length = strlen( appdata->number );
+
+	/* Everything in the table comes from the query arena, which is reset
+	for each number instead of freeing the table piece by piece. */
+	arena_reset( &appdata->query_arena );
+
+	/* Create space for the dynamic programming table. We have one column for
+	each possible letter a word can start on (all of them) */
+	table = (PartialSolution***)arena_alloc( &appdata->query_arena, 
+		length * sizeof(PartialSolution**) );
+	
+	/* for each starting pos */
+	for ( starting_pos = 0; starting_pos < length; starting_pos++ ) {
+
+		/* create the row (All words starting on that digit) */
+		table[starting_pos] = create_column(appdata, starting_pos, 
+		                                    length - starting_pos);
+	}
+
+	/* enumerate the solutions into the appdata, building them in one
+	buffer. Every letter could potentially be followed by a '-' so make it
+	twice the size we need. */
+	buffer = (char*)arena_alloc( &appdata->query_arena, length * 2 + 1 );
+	num_solutions = enumerate_solutions( appdata, table, 0, length, buffer, 
+		0, 0 );
+
+	/* free memory */
+	arena_reset( &appdata->query_arena );
+
+	return num_solutions;
+}
+
+/*
+ * Solutions of number, in place of any found before: the digits of number
+ * go into appdata->number and the entries are emptied first. 
+ *
+ * Returns the number of solutions.
+ */
+int find_solutions( AppData* appdata, const char* number )
+{
+	char* digits;
+	int i = 0;
+
+	digits = (char*)realloc(appdata->number, strlen(number) + 1);
+	if ( 0 == digits ) {
+		return 0;
+	}
+	for ( ; *number; ++number ) {
+		if ( *number >= '0' && *number <= '9' ) {
+			digits[i++] = *number;
+		}
+	}
+	digits[i] = 0;
+	appdata->number = digits;
+
+	entry_set_clear(&appdata->entries);
+	if ( 0 == i ) {
+		return 0;
+	}
+	return quick_algorithm(appdata);
+}
+
+/*
+ * Set up the working memory of searches in dict. Each thread searching
+ * the same dictionary needs its own.
+ */
+void
+init_appdata( AppData* appdata, const Dictionary* dict )
+{
+	memset(appdata, 0, sizeof(*appdata));
+
+	appdata->dict = dict;
+	arena_init(&appdata->query_arena, QUERY_ARENA_BLOCK);
+	arena_init(&appdata->entries.strings, QUERY_ARENA_BLOCK);
+	appdata->options.use_default_dict = 1;
+	memcpy(appdata->options.keymap, standard_keymap, 
+		sizeof(appdata->options.keymap));
+}
+void
+deinit_appdata( AppData* appdata )
+{
+	free(appdata->number);
+	dict_file_list_free(appdata->options.extra_dict_files);
+	entry_set_free(&appdata->entries);
+	arena_free(&appdata->query_arena);
+}
@@ -0,0 +1,169 @@
+#ifndef SPELLOPHONE_H
+#define SPELLOPHONE_H
+
+/* spellophone
+ *
+ * Algorithm to check phone numbers for words: the dictionary is loaded
+ * into one of the tries of TrieStore.h, and quick_algorithm() finds the
+ * solutions for appdata->number in a dynamic programming table built from
+ * it. TriestoreMain.c is the command line front end.
+ */
+
+#include <stdio.h>
+#include "TrieStore.h"
+#include "Arena.h"
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+/* Size of the blocks of the per-number arena. */
+#define QUERY_ARENA_BLOCK (64 * 1024)
+
+/* Minimum word -- the minimum number of characters in a word. */
+#define MINIMUM_WORD 2
+
+typedef struct _DictFileList {
+	char* str;
+	struct _DictFileList* next;
+} DictFileList;
+
+/* Represents an entry in the solution. */
+typedef struct _SolutionEntry {
+	char* str;
+	int score;
+	unsigned int hash;
+} SolutionEntry;
+
+/* 
+ * The set of solutions. Entries are kept in an array in the order they 
+ * were found, and duplicates are found through an open addressing hash 
+ * table of entry indices (linear probing, at most half full).
+ */
+typedef struct _EntrySet {
+	SolutionEntry* entries;
+	int num_entries;
+	int max_entries;
+	int* slots;          /* 1 + index of an entry, 0 for an empty slot */
+	int num_slots;       /* power of 2 */
+	Arena strings;       /* the entries' strings */
+} EntrySet;
+
+/* Options for the application from the command line. */
+typedef struct _AppOptions {
+	int use_default_dict;
+	DictFileList* extra_dict_files;
+	int show_scores;
+	int lowest_first;
+	int show_stats;
+	int max_results;     /* show only this many best solutions, if > 0 */
+	int compact_trie;
+	int digit_trie;
+	const char* keymap[10];
+} AppOptions;
+
+/* Kinds of trie for dict_init(). */
+#define DICT_TRIE 0
+#define DICT_COMPACT_TRIE 1
+#define DICT_DIGIT_TRIE 2
+
+/*
+ * The dictionary, in one of the tries, and the keypad it is searched
+ * with. It is only read once the words are in, so any number of threads
+ * can search it at the same time, each with its own AppData.
+ */
+typedef struct _Dictionary {
+	Trie* trie;
+	CompactTrie* ctrie; /* used instead of trie with -c */
+	DigitTrie* dtrie;   /* used instead of trie with -t */
+	const char* keymap[10];
+} Dictionary;
+
+/* 
+ * This is passed around -- it contains the root node of all of the solutions.
+ * It is the working memory of the searches of one thread, and points to
+ * the dictionary they run on.
+ */
+typedef struct _AppData {
+	const Dictionary* dict;
+	Arena query_arena;  /* the dynamic programming table of a number */
+	EntrySet entries;
+	char* number;
+	AppOptions options;
+} AppData;
+
+
+/*
+ * Think of the trie as a huge finite state machine. The context
+ * represents the state of that machine as a word is traversed beginning
+ * on a particular letter.
+ * 
+ * It also lets you join contexts together in a linked list.
+ */
+typedef struct _TrieContext {
+	const void* node;
+	struct _TrieContext* next;
+} TrieContext;
+
+/*
+ * A PartialSolution is a single square in the dynamic-programming
+ * grid. For example, the entry at coordinates (2,4) contains all of
+ * the partial words and completed words of length 4 beginning at
+ * the second digit of the phone number.
+ *
+ * The completed words are also copied out of the trie once, into words,
+ * so the enumeration can follow the edges of the grid (a word leads from
+ * its starting digit to the digit after it) without asking the trie again
+ * each time it gets there.
+ */
+typedef struct _PartialSolution {
+	TrieContext* partial_words;
+	TrieContext* completed_words;
+	const char** words;
+	int num_words;
+} PartialSolution;
+DictFileList* dict_file_list_add( DictFileList* head, const char* str );
+void dict_file_list_free( DictFileList* head );
+
+int entry_set_grow( EntrySet* set );
+int entry_set_add( EntrySet* set, const char* str, int score );
+void entry_set_clear( EntrySet* set );
+void entry_set_free( EntrySet* set );
+
+FILE* open_dict_file( const char* names[] );
+
+void dict_init( Dictionary* dict, int kind, const char* keymap[10] );
+void dict_free( Dictionary* dict );
+int dict_node_count( const Dictionary* dict );
+long dict_memory( const Dictionary* dict );
+
+int insert_word( Dictionary* dict, const char* word );
+const void* root_node( const Dictionary* dict );
+const void* follow_node( const Dictionary* dict, const void* node, char c );
+int is_word_node( const Dictionary* dict, const void* node );
+int node_word_count( const Dictionary* dict, const void* node );
+int get_node_word( const Dictionary* dict, const void* node, int index, 
+	char* buffer, int buffer_len );
+
+int read_dict( FILE* file, Dictionary* dict, int num_chars );
+
+void sort_entries( const EntrySet* set, SolutionEntry** sorted );
+int select_best_entries( const EntrySet* set, int limit, 
+	SolutionEntry** sorted );
+
+void collect_words( AppData* appdata, PartialSolution* solution, int length );
+PartialSolution** create_column( AppData* appdata, int starting_pos, 
+	int max_length );
+int enumerate_solutions( AppData* appdata, PartialSolution*** table, 
+	int starting_pos, int length, char* buffer, int prefix_len, int score );
+int quick_algorithm( AppData* appdata );
+int find_solutions( AppData* appdata, const char* number );
+
+void init_appdata( AppData* appdata, const Dictionary* dict );
+void deinit_appdata( AppData* appdata );
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif
@@ -3,70 +3,414 @@
 #include <string.h>
 #include "TrieStore.h"
 
-int trie_node_count = 0;
+/* Nodes per slab of the trie */
+#define TRIE_SLAB_NODES 4096
 
 /*
- * Create a trie node with the given parent. The root node has a 
- * null parent.
+ * Create an empty trie node.
  */
-TrieEntry* trie_create( TrieEntry* parent )
+static TrieEntry* 
+trie_create_node( Trie* trie )
 {
-	TrieEntry* root;
-	root = (TrieEntry*)malloc(sizeof(TrieEntry));
-	memset(root, 0, sizeof(*root));
-	root->parent = parent;
-	trie_node_count++;
+	TrieEntry* node;
+	node = (TrieEntry*)arena_calloc(&trie->nodes, sizeof(TrieEntry));
+	trie->node_count++;
 
-	return root;
+	return node;
+}
+
+Trie* trie_create( void )
+{
+	Trie* trie;
+	trie = (Trie*)malloc(sizeof(Trie));
+	memset(trie, 0, sizeof(*trie));
+	arena_init(&trie->nodes, TRIE_SLAB_NODES * sizeof(TrieEntry));
+	trie->root = trie_create_node(trie);
+
+	return trie;
+}
+
+/*
+ * Append the first length characters of word to the string table and
+ * return its id, or -1 if out of memory.
+ */
+static int
+trie_add_string( Trie* trie, const char* word, int length )
+{
+	if ( trie->num_words == trie->max_words ) {
+		int max_words = trie->max_words ? trie->max_words * 2 : 1024;
+		int* offsets = 
+			(int*)realloc(trie->word_offsets, max_words * sizeof(int));
+		if ( 0 == offsets ) {
+			return -1;
+		}
+		trie->word_offsets = offsets;
+		trie->max_words = max_words;
+	}
+
+	if ( trie->strings_size + length + 1 > trie->strings_capacity ) {
+		long capacity = trie->strings_capacity ? 
+			trie->strings_capacity * 2 : 16 * 1024;
+		char* strings;
+		while ( capacity < trie->strings_size + length + 1 ) {
+			capacity *= 2;
+		}
+		strings = (char*)realloc(trie->strings, capacity);
+		if ( 0 == strings ) {
+			return -1;
+		}
+		trie->strings = strings;
+		trie->strings_capacity = capacity;
+	}
+
+	memcpy(trie->strings + trie->strings_size, word, length);
+	trie->strings[trie->strings_size + length] = 0;
+	trie->word_offsets[trie->num_words] = trie->strings_size;
+	trie->strings_size += length + 1;
+
+	return trie->num_words++;
+}
+
+/*
+ * Follow word from node, which it reaches after from characters, adding 
+ * the nodes that are missing, and give the end node the word's id. If 
+ * path is given, path[i] receives the node reached after i+1 characters.
+ * Returns the end node, or 0 if the word could not be stored.
+ */
+static TrieEntry*
+trie_add_path( Trie* trie, TrieEntry* node, const char* word, int from,
+	TrieEntry** path )
+{
+	int i;
+
+	for ( i = from; word[i] >= '0' && word[i] <= 'Z'; ++i ) {
+		if ( node->ptr[word[i] - '0'] == 0 ) {
+			node->ptr[word[i] - '0'] = trie_create_node(trie);
+		}
+		node = node->ptr[word[i] - '0'];
+		if ( path ) {
+			path[i] = node;
+		}
+	}
+
+	if ( 0 == node->word ) {
+		int id = trie_add_string(trie, word, i);
+		if ( id < 0 ) {
+			return 0;
+		}
+		node->word = id + 1;
+	}
+	return node;
 }
 
 /*
  * Insert a word into the trie.
  */
-void trie_insert( TrieEntry* root, const char* word)
+int trie_insert( Trie* trie, const char* word)
 {
-	if ( 0 == *word ) {
-		root->end = 1;
-		return;
+	return trie_add_path(trie, trie->root, word, 0, 0) ? 0 : -1;
+}
+
+/*
+ * Insert the words one after the other, remembering the path of the 
+ * previous word so that only the part after the common prefix has to be
+ * walked.
+ */
+int trie_insert_sorted( Trie* trie, const char** words, int num_words )
+{
+	TrieEntry** path = 0;  /* path[i] is the node after i+1 characters */
+	int path_len = 0;
+	int max_path = 0;
+	const char* prev = "";
+	int i;
+
+	for ( i = 0; i < num_words; ++i ) {
+		const char* word = words[i];
+		TrieEntry* node = trie->root;
+		int len = 0;
+		int common = 0;
+
+		while ( word[len] >= '0' && word[len] <= 'Z' ) {
+			len++;
+		}
+		if ( len > max_path ) {
+			TrieEntry** new_path = 
+				(TrieEntry**)realloc(path, len * sizeof(TrieEntry*));
+			if ( 0 == new_path ) {
+				free(path);
+				return -1;
+			}
+			path = new_path;
+			max_path = len;
+		}
+
+		while ( common < len && common < path_len && 
+			word[common] == prev[common] ) {
+			common++;
+		}
+		if ( common > 0 ) {
+			node = path[common - 1];
+		}
+
+		if ( 0 == trie_add_path(trie, node, word, common, path) ) {
+			free(path);
+			return -1;
+		}
+		path_len = len;
+		prev = word;
+	}
+
+	free(path);
+	return 0;
+}
+
+TrieEntry* trie_root( const Trie* trie )
+{
+	return trie->root;
+}
+
+/*
+ * Extract a word from the trie: a copy out of the string table.
+ */
+int 
+trie_get_word( const Trie* trie, const TrieEntry* node, char* buffer, 
+	int buffer_len )
+{
+	const char* word;
+	int length;
+
+	if ( 0 == node->word ) {
+		buffer[0] = 0;
+		return 0;
+	}
+
+	word = trie->strings + trie->word_offsets[node->word - 1];
+	length = strlen(word);
+	if ( length >= buffer_len ) {
+		assert(0);
+		return 0;
+	}
+
+	memcpy(buffer, word, length + 1);
+	return length;
+}
+
+/*
+ * Traverses the trie, following it using a single letter.
+ * Returns null if adding the letter would not result in a word
+ * that exists in the trie.
+ */
+TrieEntry* trie_follow( TrieEntry* root, char c )
+{
+	assert(root);
+
+	if ( c >= '0' && c <= 'Z' ) {
+		root = root->ptr[c - '0'];
 	}
 
-	if ( *word < '0' || *word > 'Z' ) {
-		root->end = 1;
+	return root;
+}
+
+long trie_memory( const Trie* trie )
+{
+	return sizeof(Trie) + (long)trie->nodes.reserved + 
+		trie->strings_capacity + (long)trie->max_words * sizeof(int);
+}
+
+/*
+ * Destroy the trie. The nodes go with their slabs.
+ */
+void trie_destroy( Trie* trie )
+{
+	if ( 0 == trie ) {
 		return;
 	}
 
-	if ( root->ptr[*word - '0'] == 0 ) {
-		root->ptr[*word - '0'] = trie_create(root);
-		root->ptr[*word - '0']->c = *word;
+	arena_free(&trie->nodes);
+	free(trie->strings);
+	free(trie->word_offsets);
+	free(trie);
+}
+
+
+/*
+ * Number of set bits, used to rank a child among its siblings.
+ */
+static int
+popcount64( unsigned long long x )
+{
+#ifdef __GNUC__
+	return __builtin_popcountll(x);
+#else
+	int n = 0;
+	while ( x ) {
+		x &= x - 1;
+		n++;
 	}
+	return n;
+#endif
+}
+
+/*
+ * Create an empty compact trie, which contains only the root.
+ */
+CompactTrie* ctrie_create( void )
+{
+	CompactTrie* trie;
+	trie = (CompactTrie*)malloc(sizeof(CompactTrie));
+	memset(trie, 0, sizeof(*trie));
+	memset(trie->free_blocks, -1, sizeof(trie->free_blocks));
+
+	trie->capacity = 1024;
+	trie->nodes = (CompactTrieNode*)malloc(trie->capacity * sizeof(CompactTrieNode));
+	memset(&trie->nodes[0], 0, sizeof(CompactTrieNode));
+	trie->nodes[0].parent = -1;
+	trie->num_nodes = 1;
+	trie->node_count = 1;
 
-	trie_insert( root->ptr[*word - '0'], &word[1] );
+	return trie;
 }
 
 /*
- * Extract a word from the trie.
+ * Get space for a block of size nodes, reusing a freed block if there is
+ * one. Returns the index of the first node.
  */
-int 
-trie_get_word( TrieEntry* node, char* buffer, int buffer_len )
+static int
+ctrie_alloc_block( CompactTrie* trie, int size )
+{
+	int block = trie->free_blocks[size];
+
+	if ( block >= 0 ) {
+		trie->free_blocks[size] = trie->nodes[block].first;
+		return block;
+	}
+
+	if ( trie->num_nodes + size > trie->capacity ) {
+		while ( trie->num_nodes + size > trie->capacity ) {
+			trie->capacity *= 2;
+		}
+		trie->nodes = (CompactTrieNode*)realloc(trie->nodes, 
+			trie->capacity * sizeof(CompactTrieNode));
+	}
+
+	block = trie->num_nodes;
+	trie->num_nodes += size;
+	return block;
+}
+
+/*
+ * Add child c to the node, moving its children to a block one larger.
+ * Returns the index of the new child.
+ */
+static int
+ctrie_add_child( CompactTrie* trie, int node, char c )
+{
+	unsigned long long bit = 1ULL << (c - '0');
+	unsigned long long children = trie->nodes[node].children;
+	int size = popcount64(children);
+	int rank = popcount64(children & (bit - 1));
+	int old_block = trie->nodes[node].first;
+	int block = ctrie_alloc_block(trie, size + 1);
+	CompactTrieNode* nodes = trie->nodes;
+	int i;
+
+	for ( i = 0; i <= size; ++i ) {
+		CompactTrieNode* child = &nodes[block + i];
+		if ( i == rank ) {
+			memset(child, 0, sizeof(*child));
+			child->parent = node;
+			child->c = c;
+		} else {
+			int j;
+			*child = nodes[old_block + i - (i > rank)];
+			/* the grandchildren have to follow their parent */
+			for ( j = 0; j < popcount64(child->children); ++j ) {
+				nodes[child->first + j].parent = block + i;
+			}
+		}
+	}
+
+	if ( size > 0 ) {
+		nodes[old_block].first = trie->free_blocks[size];
+		trie->free_blocks[size] = old_block;
+	}
+
+	nodes[node].children = children | bit;
+	nodes[node].first = block;
+	trie->node_count++;
+
+	return block + rank;
+}
+
+/*
+ * Insert a word into the compact trie.
+ */
+void ctrie_insert( CompactTrie* trie, const char* word )
+{
+	int node = 0;
+
+	for ( ; *word >= '0' && *word <= 'Z'; ++word ) {
+		const CompactTrieNode* child = 
+			ctrie_follow(trie, &trie->nodes[node], *word);
+		if ( child ) {
+			node = child - trie->nodes;
+		} else {
+			node = ctrie_add_child(trie, node, *word);
+		}
+	}
+
+	trie->nodes[node].end = 1;
+}
+
+const CompactTrieNode* ctrie_root( const CompactTrie* trie )
+{
+	return &trie->nodes[0];
+}
+
+/*
+ * Traverses the compact trie using a single letter.
+ */
+const CompactTrieNode* ctrie_follow( const CompactTrie* trie, 
+	const CompactTrieNode* node, char c )
+{
+	unsigned long long bit;
+
+	assert(node);
+
+	if ( c < '0' || c > 'Z' ) {
+		return node;
+	}
+
+	bit = 1ULL << (c - '0');
+	if ( 0 == (node->children & bit) ) {
+		return 0;
+	}
+
+	return &trie->nodes[node->first + popcount64(node->children & (bit - 1))];
+}
+
+/*
+ * Extract a word from the compact trie.
+ */
+int ctrie_get_word( const CompactTrie* trie, const CompactTrieNode* node, 
+	char* buffer, int buffer_len )
 {
 	int length = 0;
-	int first_node = 0;
 	int i = 0;
 
-	while( node->parent ) {
+	while( node->parent >= 0 ) {
 		if ( length >= buffer_len ) {
 			assert(0);
 			return 0;
 		}
 
 		buffer[length] = node->c;
-		node = node->parent;
+		node = &trie->nodes[node->parent];
 		length++;
 	}
 
 	buffer[length] = 0;
 
-
 	/* now reverse the word, since we got it backwards */
 	for ( i = 0; i < ( length >> 1 ); ++i ) {
 		char c;
@@ -75,42 +419,130 @@ trie_get_word( TrieEntry* node, char* buffer, int buffer_len )
 		buffer[length - i - 1] = c;
 	}
 
-
 	return length;
 }
 
-/*
- * Traverses the trie, following it using a single letter.
- * Returns null if adding the letter would not result in a word
- * that exists in the trie.
- */
-TrieEntry* trie_follow( TrieEntry* root, char c )
+long ctrie_memory( const CompactTrie* trie )
 {
-	assert(root);
+	return sizeof(CompactTrie) + (long)trie->capacity * sizeof(CompactTrieNode);
+}
 
-	if ( c >= '0' && c <= 'Z' ) {
-		root = root->ptr[c - '0'];
+void ctrie_destroy( CompactTrie* trie )
+{
+	if ( 0 == trie ) {
+		return;
 	}
 
-	return root;
+	free(trie->nodes);
+	free(trie);
 }
 
-/*
- * Recursively destroy the trie.
- */
-void trie_destroy( TrieEntry* root )
+/* Bytes per slab of the digit trie */
+#define DTRIE_SLAB_SIZE (256 * 1024)
+
+static DigitTrieNode*
+dtrie_create_node( DigitTrie* trie )
 {
-	char c;
+	DigitTrieNode* node;
+	node = (DigitTrieNode*)arena_calloc(&trie->memory, sizeof(DigitTrieNode));
+	trie->node_count++;
 
-	if ( 0 == root ) {
-		return;
+	return node;
+}
+
+DigitTrie* dtrie_create( const char* keymap[10] )
+{
+	DigitTrie* trie;
+	int d;
+
+	trie = (DigitTrie*)malloc(sizeof(DigitTrie));
+	memset(trie, 0, sizeof(*trie));
+	arena_init(&trie->memory, DTRIE_SLAB_SIZE);
+
+	for ( d = 9; d >= 0; --d ) {
+		const char* key;
+		for ( key = keymap[d]; *key; ++key ) {
+			if ( *key >= '0' && *key <= 'Z' ) {
+				trie->digits[*key - '0'] = '0' + d;
+			}
+		}
 	}
 
-	for( c = '0'; c <= 'Z'; ++c ) {
-		trie_destroy( root->ptr[c - '0'] );
+	trie->root = dtrie_create_node(trie);
+	return trie;
+}
+
+void dtrie_insert( DigitTrie* trie, const char* word )
+{
+	DigitTrieNode* node = trie->root;
+	const char* end = word;
+	int i;
+
+	/* check that the whole word can be typed before adding nodes */
+	for ( ; *end >= '0' && *end <= 'Z'; ++end ) {
+		if ( 0 == trie->digits[*end - '0'] ) {
+			return;
+		}
 	}
 
-	free(root);
-	trie_node_count--;
+	for ( i = 0; word + i < end; ++i ) {
+		int d = trie->digits[word[i] - '0'] - '0';
+		if ( 0 == node->ptr[d] ) {
+			node->ptr[d] = dtrie_create_node(trie);
+		}
+		node = node->ptr[d];
+	}
+
+	for ( i = 0; i < node->num_words; ++i ) {
+		if ( 0 == strncmp(node->words[i], word, end - word) && 
+			0 == node->words[i][end - word] ) {
+			return;
+		}
+	}
+
+	/* grow the word list; the old one stays in the arena unused */
+	if ( node->num_words == node->max_words ) {
+		char** words = node->words;
+		node->max_words = node->max_words ? node->max_words * 2 : 2;
+		node->words = (char**)arena_alloc(&trie->memory, 
+			node->max_words * sizeof(char*));
+		memcpy(node->words, words, node->num_words * sizeof(char*));
+	}
+
+	node->words[node->num_words] = (char*)arena_alloc(&trie->memory, 
+		end - word + 1);
+	memcpy(node->words[node->num_words], word, end - word);
+	node->words[node->num_words][end - word] = 0;
+	node->num_words++;
+}
+
+const DigitTrieNode* dtrie_root( const DigitTrie* trie )
+{
+	return trie->root;
+}
+
+const DigitTrieNode* dtrie_follow( const DigitTrieNode* node, char digit )
+{
+	assert(node);
+
+	if ( digit < '0' || digit > '9' ) {
+		return 0;
+	}
+
+	return node->ptr[digit - '0'];
+}
+
+long dtrie_memory( const DigitTrie* trie )
+{
+	return sizeof(DigitTrie) + (long)trie->memory.reserved;
 }
 
+void dtrie_destroy( DigitTrie* trie )
+{
+	if ( 0 == trie ) {
+		return;
+	}
+
+	arena_free(&trie->memory);
+	free(trie);
+}
@@ -10,32 +10,57 @@
  * be polite to let me know!
  */
 
+#include "Arena.h"
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
 typedef struct _TrieEntry {
-	char c;
-	int end;
-	struct _TrieEntry* parent;
+	int word;            /* 1 + id of the word ending here, 0 if none */
 	struct _TrieEntry* ptr[50];
 } TrieEntry;
 
 /*
- * Create a trie.
- *
- * Parameters:
- *    parent -- NULL, or child to create it from. 
- *       (normally call it with null, trie_insert uses this parameter
- *        to add to the trie.)
+ * The trie owns its nodes, which are allocated from slabs so that 
+ * destroying it only frees the slabs. The words themselves are kept
+ * one after the other in a string table, indexed by word id.
  */
+typedef struct _Trie {
+	TrieEntry* root;
+	Arena nodes;
+	int node_count;
+	char* strings;       /* '\0' terminated words */
+	long strings_size;
+	long strings_capacity;
+	int* word_offsets;   /* offset in strings of each word id */
+	int num_words;
+	int max_words;
+} Trie;
 
-TrieEntry* trie_create( TrieEntry* parent );
+/*
+ * Create an empty trie.
+ */
+Trie* trie_create( void );
 
 /* 
- * Insert into the trie.
+ * Insert into the trie. Returns 0, or -1 if out of memory.
  *
  * Example:
- *   TrieEntry* trie = trie_create(NULL);
+ *   Trie* trie = trie_create();
  *   trie_insert(trie, "keyword");
  */
-void trie_insert( TrieEntry* root, const char* word);
+int trie_insert( Trie* trie, const char* word);
+
+/*
+ * Insert many words at once. Each word only walks the trie from where it
+ * stops sharing a prefix with the word before it, so the words should be
+ * sorted; any order gives the same trie, just slower.
+ * Returns 0, or -1 if out of memory.
+ */
+int trie_insert_sorted( Trie* trie, const char** words, int num_words );
+
+TrieEntry* trie_root( const Trie* trie );
 
 /*
  * follow a chain in the trie.
@@ -52,25 +77,139 @@ void trie_insert( TrieEntry* root, const char* word);
 TrieEntry* trie_follow( TrieEntry* root, char c );
 
 /*
- * Retrieve a word from a node obtained from trie_follow().
+ * Retrieve the word ending at a node obtained from trie_follow(). 
+ * Returns its length, or 0 if no word ends there.
  *
  * Example:
  *   trie_insert(trie, "the");
- *   trie = trie_follow(trie, 't');
- *   trie = trie_follow(trie, 'h');
- *   trie = trie_follow(trie, 'e');
+ *   node = trie_follow(trie_root(trie), 't');
+ *   node = trie_follow(node, 'h');
+ *   node = trie_follow(node, 'e');
  *   char buffer[10];
- *   trie_get_word(trie, buffer, 10);
+ *   trie_get_word(trie, node, buffer, 10);
  *   assert(0 == strcmp(buffer, "the"));
  */
-int trie_get_word( TrieEntry* node, char* buffer, int buffer_len );
+int trie_get_word( const Trie* trie, const TrieEntry* node, char* buffer, 
+	int buffer_len );
 
 
+/*
+ * Bytes allocated for the nodes and the string table.
+ */
+long trie_memory( const Trie* trie );
+
 /* 
  * destroy the trie data structure.
  */
 
-void trie_destroy( TrieEntry* root );
+void trie_destroy( Trie* trie );
+
+/* Compact Trie
+ *
+ * Same operations as above, but all nodes live in one array. A node keeps
+ * a bitmap of its children, which are stored next to each other in
+ * character order, so following a letter is a bit test plus a popcount to
+ * find the child's slot. A node takes 24 bytes instead of the ~420 of a
+ * TrieEntry.
+ *
+ * Node pointers returned by ctrie_root()/ctrie_follow() are only valid
+ * until the next ctrie_insert(), since inserting may move nodes.
+ */
+
+#define CTRIE_ALPHABET ('Z' - '0' + 1)
+
+typedef struct _CompactTrieNode {
+	unsigned long long children; /* bit (c - '0') set for each child */
+	int first;                   /* index of the first child */
+	int parent;                  /* index of the parent, -1 for the root */
+	char c;
+	char end;
+} CompactTrieNode;
+
+typedef struct _CompactTrie {
+	CompactTrieNode* nodes;
+	int num_nodes;       /* slots used in nodes, including freed blocks */
+	int capacity;
+	int node_count;      /* nodes in the trie */
+	/* freed blocks of children by size, linked through their first node */
+	int free_blocks[CTRIE_ALPHABET + 1];
+} CompactTrie;
+
+CompactTrie* ctrie_create( void );
+
+void ctrie_insert( CompactTrie* trie, const char* word );
+
+const CompactTrieNode* ctrie_root( const CompactTrie* trie );
+
+/*
+ * Returns NULL if adding the letter does not result in a word. See
+ * trie_follow().
+ */
+const CompactTrieNode* ctrie_follow( const CompactTrie* trie, 
+	const CompactTrieNode* node, char c );
+
+int ctrie_get_word( const CompactTrie* trie, const CompactTrieNode* node, 
+	char* buffer, int buffer_len );
+
+/*
+ * Bytes allocated for the nodes.
+ */
+long ctrie_memory( const CompactTrie* trie );
+
+void ctrie_destroy( CompactTrie* trie );
+
+/* Digit Trie
+ *
+ * A trie keyed by the digits of the phone keypad: each word is inserted
+ * along the digits that spell it (e.g. "CALL" under 2-2-5-5) and the node
+ * the last digit leads to holds the list of all words spelled that way.
+ * One child lookup per digit replaces following each of the 3-4 letters
+ * of the key in the letter trie.
+ */
+
+typedef struct _DigitTrieNode {
+	struct _DigitTrieNode* ptr[10];
+	char** words;       /* words ending here */
+	int num_words;
+	int max_words;
+} DigitTrieNode;
+
+typedef struct _DigitTrie {
+	DigitTrieNode* root;
+	char digits[CTRIE_ALPHABET]; /* digit of each letter, 0 if none */
+	int node_count;
+	Arena memory;       /* nodes, word lists and words */
+} DigitTrie;
+
+/*
+ * Create a digit trie for a keypad, where keymap[d] lists the letters on
+ * digit d. A letter on several keys is taken to be on the first one.
+ */
+DigitTrie* dtrie_create( const char* keymap[10] );
+
+/*
+ * Insert a word. Words are cut at the first character outside '0'..'Z', 
+ * like trie_insert(), and skipped if they have a letter that is on no key.
+ */
+void dtrie_insert( DigitTrie* trie, const char* word );
+
+const DigitTrieNode* dtrie_root( const DigitTrie* trie );
+
+/*
+ * Follow a digit ('0'..'9'). Returns NULL if no word continues with it.
+ */
+const DigitTrieNode* dtrie_follow( const DigitTrieNode* node, char digit );
+
+/*
+ * Bytes allocated for nodes and words.
+ */
+long dtrie_memory( const DigitTrie* trie );
+
+void dtrie_destroy( DigitTrie* trie );
+
+#ifdef __cplusplus
+}
+#endif
 
 #endif
 
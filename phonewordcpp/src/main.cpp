@@ -1,80 +1,52 @@
 #include <string.h>
+#include <stdlib.h>
 #include <ctype.h>
-#include <iostream>
-#include <algorithm>
-#include <fstream>
-#include <sstream>
-#include <list>
-#include <iterator>
-#include <unordered_map>
-#include <memory>
-#include <assert.h>
+#include <errno.h>
+#include <signal.h>
+#include <unistd.h>
+#include <fcntl.h>
+#include <poll.h>
+#include <pthread.h>
+#include <sys/socket.h>
+#include <sys/un.h>
+#include <set>
+#include <thread>
+#include <mutex>
+#include <condition_variable>
+#include "PhoneNumberWord.h"
+#include "PhonewordText.h"
 
 #ifdef TIME_IT
 #include <sys/time.h>
 #endif
 
-#ifdef _UNICODE
-#define _T(text) L##text
-#else
-#define _T(text) text
-#endif
-namespace jz{
-#ifdef _UNICODE
-typedef wchar_t Char;
-typedef ::std::wstring String;
-typedef ::std::wifstream Ifstream;
-typedef ::std::wofstream Ofstream;
-typedef ::std::wstringstream Stringstream;
-typedef ::std::wostream Ostream;
-#define Cout ::std::wcout
-#else
-typedef char Char;
-typedef ::std::string String;
-typedef ::std::ifstream Ifstream;
-typedef ::std::ofstream Ofstream;
-typedef ::std::stringstream Stringstream;
-typedef ::std::ostream Ostream;
-#define Cout std::cout
-#endif
-
-
-typedef std::list<String> StringList;
-typedef std::unordered_map<Char, Char> CharCharMap;
-typedef std::unordered_map<Char, String> CharStringMap;
-typedef std::unordered_map<String, std::list<String> > StringStringListMap;
-
-template <typename T>
-class Matrix {
-    std::vector<T> data;
-
-    Matrix(const Matrix&){}
-    Matrix& operator=(const Matrix&){}
-public:
-    typedef Matrix<T> ThisType;
-    const int NROW, NCOL, SIZE;
+// Bytes allocated by each thread, for --stats. All of the program's
+// allocations come through here; counting costs a thread local add.
+static thread_local unsigned long long allocatedBytes = 0;
 
-    Matrix(std::size_t nrow, std::size_t ncol)
-        : NROW(nrow), NCOL(ncol), SIZE(nrow*ncol), data(nrow*ncol)
-    {}
-    inline std::size_t size() const {
-        return SIZE;
-    }
-    inline T& operator[](std::size_t i) {
-        assert(i<SIZE);
-        return data[i];
-    }
-    T& operator()(std::size_t i, std::size_t j) {
-        assert(i < NROW && j < NCOL);
-        return (*this)[i*NCOL +j];
-    }
-    const T& operator()(std::size_t i, std::size_t j) const{
-        ThisType& me = const_cast<ThisType&>(*this);
-        return me(i,j);
-    }
-};
+void* operator new(std::size_t size) {
+    allocatedBytes += size;
+    void *p = malloc(size ? size : 1);
+    if( p == NULL ) throw std::bad_alloc();
+    return p;
+}
+// the temporary buffers of std::inplace_merge() and friends
+void* operator new(std::size_t size, const std::nothrow_t&) noexcept {
+    allocatedBytes += size;
+    return malloc(size ? size : 1);
+}
+void operator delete(void *p) noexcept {
+    free(p);
+}
+void operator delete(void *p, std::size_t) noexcept {
+    free(p);
+}
+// for the loader threads of PhoneNumberWord
+static unsigned long long threadAllocatedBytes() {
+    return allocatedBytes;
+}
 
-typedef Matrix<StringList> StringListMatrix;
+namespace jz{
 
 #ifdef TIME_IT
 long long current_timestamp() {
@@ -86,206 +58,457 @@ long long current_timestamp() {
 }
 #endif
 
-struct PhoneNumberWord {
-    enum { MAX_LINE_LEN = 128, MIN_WORD_LEN = 2 };
-    int minWordLen;
-
-    PhoneNumberWord(): minWordLen(MIN_WORD_LEN) {
-        //
-        CharStringMap d2a;
-        d2a[_T('2')] = _T("ABC");
-        d2a[_T('3')] = _T("DEF");
-        d2a[_T('4')] = _T("GHI");
-        d2a[_T('5')] = _T("JKL");
-        d2a[_T('6')] = _T("NMO");
-        d2a[_T('7')] = _T("PQRS");
-        d2a[_T('8')] = _T("TUV");
-        d2a[_T('9')] = _T("WXYZ");
-
-        for(CharStringMap::iterator it=d2a.begin(); it!=d2a.end(); ++it) {
-            String& w=it->second;
-            Char d = it->first;
-            for(String::iterator itc=w.begin(); itc!=w.end(); ++itc) {
-                a2d[*itc] = d;
-            }
+// Persistent server: the dictionary is loaded once and numbers are served
+// over a Unix domain socket. A request is one number per line; the reply is
+// the number, its combinations one per line, and an empty line marking the
+// end. Empty requests are ignored and get no reply, so the echoed number is
+// never taken for the end of a reply.
+// Connections are handed to a fixed pool of workers which all share the
+// same (immutable) PhoneNumberWord. A worker serves one connection until the
+// client hangs up, so at most nworkers clients are served at a time; the
+// others wait, connected, until a worker is free.
+class PhoneWordServer {
+public:
+    PhoneWordServer(const PhoneNumberWord& pnw, int nworkers)
+        : pnw(pnw), nworkers(nworkers < 1 ? 1 : nworkers), listenFd(-1), stopping(false)
+    {}
+
+    int serve(const char *socketPath) {
+        struct sockaddr_un addr;
+        memset(&addr, 0, sizeof(addr));
+        addr.sun_family = AF_UNIX;
+        if( strlen(socketPath) >= sizeof(addr.sun_path) ) {
+            printf("Socket path too long: %s\n", socketPath);
+            return -1;
+        }
+        strcpy(addr.sun_path, socketPath);
+        listenFd = socket(AF_UNIX, SOCK_STREAM, 0);
+        unlink(socketPath);
+        if( listenFd < 0 || bind(listenFd, (struct sockaddr*)&addr, sizeof(addr)) != 0
+            || listen(listenFd, SOMAXCONN) != 0 ) {
+            printf("Failed to listen on %s: %s\n", socketPath, strerror(errno));
+            if( listenFd >= 0 ) ::close(listenFd);
+            return -1;
         }
-    }
 
-    void processDic() {
-        for(StringList::iterator it=words.begin(); it!= words.end(); ++it) {
-            String& w(*it);
-            String number;
-            int n = 0;
-            for(String::iterator itc=w.begin(); itc!=w.end(); ++itc) {
-                CharCharMap::iterator itd = a2d.find(*itc);
-                if( itd == a2d.end() ) { // unknown letter
-                    n = 0;
-                    break;
-                }
-               number += itd->second;
+        // stop accepting on SIGINT/SIGTERM: the handler writes to a pipe
+        // that is polled along with the listening socket, so a signal can't
+        // slip in between a check and a blocking accept()
+        if( pipe(signalPipe) != 0 ) {
+            printf("Failed to create a pipe: %s\n", strerror(errno));
+            ::close(listenFd);
+            return -1;
+        }
+        fcntl(signalPipe[1], F_SETFL, O_NONBLOCK);
+        // a client gone before accept() must not block the loop
+        fcntl(listenFd, F_SETFL, O_NONBLOCK);
+        struct sigaction sa;
+        memset(&sa, 0, sizeof(sa));
+        sa.sa_handler = onSignal;
+        sigaction(SIGINT, &sa, NULL);
+        sigaction(SIGTERM, &sa, NULL);
+        signal(SIGPIPE, SIG_IGN);
+
+        // the workers inherit a mask blocking the signals, so only this
+        // thread takes them
+        sigset_t stopSignals, oldMask;
+        sigemptyset(&stopSignals);
+        sigaddset(&stopSignals, SIGINT);
+        sigaddset(&stopSignals, SIGTERM);
+        pthread_sigmask(SIG_BLOCK, &stopSignals, &oldMask);
+        std::vector<std::thread> workers;
+        for(int i=0; i<nworkers; ++i) {
+            workers.push_back(std::thread(&PhoneWordServer::work, this));
+        }
+        pthread_sigmask(SIG_SETMASK, &oldMask, NULL);
+
+        struct pollfd fds[2];
+        fds[0].fd = listenFd;
+        fds[0].events = POLLIN;
+        fds[1].fd = signalPipe[0];
+        fds[1].events = POLLIN;
+        for(;;) {
+            if( poll(fds, 2, -1) < 0 ) {
+                if( errno == EINTR ) continue;
+                printf("poll failed: %s\n", strerror(errno));
+                break;
             }
-            StringList &sl = n2w[number];
-            if( number.length() > 1 && std::find(sl.begin(), sl.end(), w) == sl.end() ) {
-                n2w[number].push_back( w );
+            if( fds[1].revents != 0 ) break;
+            if( fds[0].revents == 0 ) continue;
+            int fd = accept(listenFd, NULL, NULL);
+            if( fd < 0 ) {
+                if( errno == EINTR || errno == ECONNABORTED
+                    || errno == EAGAIN || errno == EWOULDBLOCK ) continue;
+                printf("accept failed: %s\n", strerror(errno));
+                break;
             }
+            std::lock_guard<std::mutex> lock(mtx);
+            pending.push_back(fd);
+            cond.notify_one();
+        }
+
+        // wake up idle workers and cut off the clients still connected
+        {
+            std::lock_guard<std::mutex> lock(mtx);
+            stopping = true;
+            for(std::set<int>::iterator it=active.begin(); it!=active.end(); ++it) {
+                shutdown(*it, SHUT_RDWR);
+            }
+            cond.notify_all();
+        }
+        for(size_t i=0; i<workers.size(); ++i) {
+            workers[i].join();
         }
+        ::close(listenFd);
+        ::close(signalPipe[0]);
+        ::close(signalPipe[1]);
+        unlink(socketPath);
+        return 0;
     }
 
-    void setMinWordLength(int len) {
-        minWordLen = len;
+private:
+    static void onSignal(int) {
+        const int savedErrno = errno;
+        const char c = 0;
+        // a full pipe already holds a wake-up
+        if( write(signalPipe[1], &c, 1) < 0 ) {}
+        errno = savedErrno;
     }
 
-    bool loadDict(const char *filename = "/usr/share/dict/words") {
-        Ifstream file(filename);
-        if( !file.is_open() ) return false;
-        Char buf[MAX_LINE_LEN];
-        int nline = 0;
-        while( file.getline(buf, MAX_LINE_LEN) ) {
-            String line(buf);
-            String s;
-            bool validWord = true;
-            for(String::iterator it=line.begin(); it!=line.end(); ++it) {
-                if( isalpha(*it) ) {
-                    s += toupper(*it);
-                }else if( *it == '\'' || *it=='-' ) {
-                    break;
-                }else{
-                    validWord = false;
-                    break;
+    void work() {
+        for(;;) {
+            int fd;
+            {
+                std::unique_lock<std::mutex> lock(mtx);
+                while( pending.empty() && !stopping ) {
+                    cond.wait(lock);
                 }
+                if( stopping ) break;
+                fd = pending.front();
+                pending.pop_front();
+                active.insert(fd);
             }
-            if( validWord && s.length() >= minWordLen ) {
-                words.push_back(s);
+            handle(fd);
+            {
+                std::lock_guard<std::mutex> lock(mtx);
+                active.erase(fd);
             }
-            ++nline;
+            ::close(fd);
         }
-        processDic();
-        return true;
-    }
-
-    // dynamic programming to store matched words
-    //                     Matched String Matrix
-    //             _____________ startPos ___________________
-    //             |         0            1        2        3
-    //             | 2       AD
-    // wordLength  | 3       BOB,BIZ
-    //             | 4
-    //
-    void findWord(String adigits, Ostream& os) const {
-        String digits;
-        for(int i=0; i< adigits.length(); ++i) // ignore all non-digits
-            if( isdigit(adigits[i]) )
-                digits += adigits[i];
-        const size_t N = digits.length();
-        if( N == 0) {
-            os << "No digits in " << adigits << std::endl;
-            return ;
+        std::lock_guard<std::mutex> lock(mtx);
+        for(std::list<int>::iterator it=pending.begin(); it!=pending.end(); ++it) {
+            ::close(*it);
         }
-        StringListMatrix m(N+1, N);
-        for(int i=0; i<N-1; ++i) {  // scan
-            if( isSep(digits[i]) ) continue;
-            if( isSep(digits[i+1]) ) {
-                ++i;
-                continue;
-            }
+        pending.clear();
+    }
 
-            for(int j=i+minWordLen; j<=N; ++j) { // end of string
-                matchWord(digits.substr(i, j-i), i, j-i, m);
-                if( j == N || isSep(digits[j]) ) {  // separator
-                    break;
+    // serve newline-delimited numbers until the client hangs up
+    void handle(int fd) const {
+        String line;
+        Char buf[4096];
+        PhoneNumberWord::Scratch scratch;
+        for(;;) {
+            ssize_t n = read(fd, buf, sizeof(buf));
+            if( n < 0 && errno == EINTR ) continue;
+            if( n <= 0 ) return;
+            for(ssize_t i=0; i<n; ++i) {
+                if( buf[i] != _T('\n') ) {
+                    line += buf[i];
+                    continue;
                 }
+                if( !line.empty() && line[line.length()-1] == _T('\r') ) {
+                    line.erase(line.length()-1);
+                }
+                if( line.empty() ) continue;
+                Stringstream ss;
+                ss << line << std::endl;
+                pnw.findWord(line, ss, scratch);
+                ss << std::endl;
+                line.clear();
+                if( !writeAll(fd, ss.str()) ) return;
             }
         }
-        // fill the matchedowrds
-//        printMatrix(m, os);
-        StringList sl;
-        printWords(digits, m, sl);
-        std::ostream_iterator<String> outit(os, "\n");
-        std::copy(sl.begin(), sl.end(), outit);
     }
-    static bool isSep(Char c) {
-        return !isdigit(c) || c == _T('1') || c == _T('0');
+
+    static bool writeAll(int fd, const String& s) {
+        const Char *p = s.data();
+        size_t left = s.length();
+        while( left > 0 ) {
+            ssize_t n = send(fd, p, left, MSG_NOSIGNAL);
+            if( n < 0 && errno == EINTR ) continue;
+            if( n <= 0 ) return false;
+            p += n;
+            left -= n;
+        }
+        return true;
     }
 
+    const PhoneNumberWord& pnw;
+    int nworkers;
+    int listenFd;
+    std::mutex mtx;
+    std::condition_variable cond;
+    std::list<int> pending;  // accepted connections waiting for a worker
+    std::set<int> active;    // connections being served
+    bool stopping;
+    static int signalPipe[2];  // written by onSignal(), polled by serve()
+};
+
+int PhoneWordServer::signalPipe[2] = { -1, -1 };
+
+// Supplies the numbers to process one at a time.
+struct NumberSource {
+    virtual ~NumberSource() {}
+    // false when there are no more numbers
+    virtual bool next(String& num) = 0;
+};
 
-    // return count ofmatched words
-    void matchWord(const String& num, int startpos, int length, StringListMatrix& matchedWords) const {
-        StringStringListMap::const_iterator it = n2w.find(num);
-        if( it != n2w.end() )
-            matchedWords(length, startpos) = it->second;
+// Numbers separated by comma in a single string.
+class ListNumberSource: public NumberSource {
+public:
+    explicit ListNumberSource(const String& numbers): numbers(numbers), currPos(0)
+    {}
+    bool next(String& num) {
+        const Char DEL = _T(',');
+        if( currPos >= numbers.length() ) return false;
+        size_t pos = numbers.find_first_of(DEL, currPos);
+        if( pos == String::npos ) {
+            pos = numbers.length();
+        }
+        num.assign(numbers, currPos, pos-currPos);
+        currPos = pos + 1;
+        return true;
     }
-    void printMatrix( StringListMatrix& m, Ostream& os ) const {
-        os << "<startPos, length: matched Strings>" << std::endl;
-        for(int i=minWordLen; i<m.NROW; ++i) {
-            for(int j=0; j<m.NCOL; ++j) {
-                if( m(i,j).size() > 0 ) {
-                    os << "<" << j << "," << i << ":";
-                    for(StringList::iterator it=m(i,j).begin(); it != m(i,j).end(); ++it) {
-                        os << *it << " ";
-                    }
-                    os << ">" << std::endl;
-                }
+private:
+    const String& numbers;
+    size_t currPos;
+};
+
+// Numbers read from a stream as they arrive. Both newline and comma end a
+// number, so each one can be matched as soon as it is complete and only
+// the number being read is buffered. Empty entries are skipped; end of
+// stream or two consecutive empty lines terminate the input.
+class StreamNumberSource: public NumberSource {
+public:
+    explicit StreamNumberSource(std::basic_istream<Char>& is): is(is), emptyLines(0), lineEmpty(true), done(false)
+    {}
+    bool next(String& num) {
+        typedef std::basic_istream<Char>::traits_type Traits;
+        num.clear();
+        while( !done ) {
+            Traits::int_type c = is.get();
+            if( Traits::eq_int_type(c, Traits::eof()) ) {
+                done = true;
+                break;
+            }
+            if( c == _T('\n') ) {
+                emptyLines = lineEmpty ? emptyLines+1 : 0;
+                done = emptyLines == 2;
+                lineEmpty = true;
+                if( !num.empty() ) break;
+                continue;
             }
+            if( c == _T('\r') ) continue;
+            lineEmpty = false;
+            if( c == _T(',') ) {
+                if( !num.empty() ) break;
+                continue;
+            }
+            num += Traits::to_char_type(c);
         }
+        return !num.empty();
     }
+private:
+    std::basic_istream<Char>& is;
+    int emptyLines;  // consecutive empty lines seen
+    bool lineEmpty;  // nothing read on the current line yet
+    bool done;
+};
+
+// --stats: where the time and the memory of a run went. Printed to stderr
+// at the end, one "name value" per line, so the output is unchanged.
+struct RunStats {
+    LoadStats load;
+    MatchStats match;
+    long long outputNs;  // writing out the pool's results; findWord()'s writes (into the
+                         // workers' buffers with -j) are in match
+    unsigned long long loadBytes;    // allocated while loading
+    unsigned long long lookupBytes;  // allocated by the lookups and their output
+    RunStats(): outputNs(0), loadBytes(0), lookupBytes(0) {}
 
-    void printWords(const String& digits, const StringListMatrix& m, StringList& os) const {
-        combineWords(0, digits, m, String(), os);
+    void print(FILE *f, const DictIndex& index) {
+        fprintf(f, "load_ns %lld\n", load.readNs);
+        fprintf(f, "encode_ns %lld\n", load.encodeNs);
+        fprintf(f, "index_build_ns %lld\n", load.buildNs);
+        fprintf(f, "match_ns %lld\n", match.matchNs);
+        fprintf(f, "enumerate_ns %lld\n", match.enumerateNs);
+        fprintf(f, "output_ns %lld\n", outputNs + match.outputNs);
+        fprintf(f, "numbers %llu\n", match.numbers);
+        fprintf(f, "lookups %llu\n", match.lookups);
+        fprintf(f, "hits %llu\n", match.hits);
+        fprintf(f, "cells %llu\n", match.cells);
+        fprintf(f, "combinations %llu\n", match.combinations);
+        fprintf(f, "load_bytes_allocated %llu\n", loadBytes);
+        fprintf(f, "lookup_bytes_allocated %llu\n", lookupBytes);
+
+        const DictIndexHeader& h = index.layout();
+        fprintf(f, "index_mapped %d\n", index.isMapped() ? 1 : 0);
+        fprintf(f, "index_bytes %u\n", h.imageSize);
+        fprintf(f, "index_slots_bytes %zu\n", h.numSlots * sizeof(DictIndexSlot));
+        fprintf(f, "index_states_bytes %zu\n", h.numStates * sizeof(DictIndexState));
+        fprintf(f, "index_long_keys_bytes %zu\n", h.numLongKeys * sizeof(DictIndexKey) + h.keyPoolSize);
+        fprintf(f, "index_words_bytes %zu\n", h.numWords * sizeof(uint32_t) + h.wordPoolSize);
+
+        const LatencyHistogram& lat = match.latency;
+        if( lat.count == 0 ) return;
+        fprintf(f, "latency_ns_min %lld\n", lat.min);
+        fprintf(f, "latency_ns_p50 %lld\n", lat.percentile(50));
+        fprintf(f, "latency_ns_p90 %lld\n", lat.percentile(90));
+        fprintf(f, "latency_ns_p99 %lld\n", lat.percentile(99));
+        fprintf(f, "latency_ns_max %lld\n", lat.max);
+        fprintf(f, "latency_ns_mean %lld\n", lat.sum / (long long)lat.count);
     }
-    void combineWords(int startpos, const String& digits, const StringListMatrix& m, String pre, StringList& os) const {
-        int NR = m.NROW;
-        int NC = m.NCOL;
-        static const char SEP='-';
-        if( startpos == digits.length() ) { // end of string, print
-            Stringstream ss;
-            // remove unnecessary SEP
-            int i = 0;
-            while(pre[i++] == SEP) ;
-            --i;
-            for(; i< pre.length(); ++i) {
-                if( pre[i] == SEP && (pre[i+1] == SEP || 0==(isalpha(pre[i-1]) + isalpha(pre[i+1]))) ) {
-                    continue;
-                }
-                ss << pre[i];
+};
+
+// Processes numbers from a NumberSource on a pool of threads.
+// Workers pull the next number as soon as they are done with the previous
+// one, so a number with a huge count of combinations only holds up its
+// own worker while the others keep draining the input. Each result is
+// rendered into a private buffer and the calling thread writes the buffers
+// out in input order. At most `window` results are in flight, which bounds
+// memory however long the input is.
+class BatchRunner {
+public:
+    // the run is measured into stats if it is set
+    BatchRunner(const PhoneNumberWord& pnw, int nworkers, RunStats *stats = NULL)
+        : pnw(pnw), nworkers(nworkers < 1 ? 1 : nworkers), window(this->nworkers*16), stats(stats),
+          source(NULL), results(window), nextSeq(0), emitted(0), exhausted(false)
+    {}
+
+    void run(NumberSource& src, Ostream& os) {
+        String num;
+        if( nworkers == 1 ) {
+            PhoneNumberWord::Scratch scratch;
+            MatchStats local;
+            const unsigned long long bytes0 = allocatedBytes;
+            if( stats ) scratch.stats = &local;
+            // written straight to os; findWord() times its own writes
+            while( src.next(num) ) {
+                const long long t0 = stats ? monotonicNs() : 0;
+                os << num << std::endl;
+                if( stats ) local.outputNs += monotonicNs() - t0;
+                pnw.findWord(num, os, scratch);
+                const long long t1 = stats ? monotonicNs() : 0;
+                os.flush();
+                if( stats ) local.outputNs += monotonicNs() - t1;
+            }
+            if( stats ) {
+                stats->match.merge(local);
+                stats->lookupBytes += allocatedBytes - bytes0;
             }
-            os.push_back(ss.str());
             return;
         }
-        // search for next matched word
-        int minStep = 0;
-        int minStart = startpos;
-        for(int j=startpos; j<NC && minStep==0; ++j) {
-            for(int i=minWordLen; i<NR; ++i) {
-                if( m(i,j).size() > 0 ) {
-                    String w = pre + SEP + digits.substr(startpos, j-startpos) + SEP;
-                    for(StringList::const_iterator it=m(i,j).begin(); it != m(i,j).end(); ++it) {
-                        combineWords(j+i, digits, m, w + (*it), os);
-                    }
-                    if( minStep == 0 ) {
-                        minStep = i;
-                        minStart = j;
-                    }
+        source = &src;
+        std::vector<std::thread> workers;
+        for(int i=0; i<nworkers; ++i) {
+            workers.push_back(std::thread(&BatchRunner::work, this));
+        }
+        for(;;) {
+            String out;
+            {
+                std::unique_lock<std::mutex> lock(mtx);
+                while( !results[emitted % window].ready && !(exhausted && emitted == nextSeq) ) {
+                    doneCond.wait(lock);
                 }
+                Result& r = results[emitted % window];
+                if( !r.ready ) break;  // all emitted
+                out.swap(r.text);
+                r.ready = false;
+                ++emitted;
+                workCond.notify_one();
             }
+            write(os, out);
         }
-        if( minStep == 0 ) {
-            combineWords(digits.length(), digits, m, pre + SEP + digits.substr(startpos, digits.length()-startpos), os);
-        }else{
-            // search for next match with starting position before minStep
-            for(int j=minStart+1; j<=minStep; ++j) {
-                for(int i=minWordLen; i<NR; ++i) {
-                    if( m(i,j).size() > 0 ) {
-                        combineWords(j, digits, m, pre + SEP + digits.substr(startpos, j-startpos), os);
-                        return;
+        for(size_t i=0; i<workers.size(); ++i) {
+            workers[i].join();
+        }
+    }
+
+private:
+    struct Result {
+        String text;
+        bool ready;
+        Result(): ready(false) {}
+    };
+
+    void write(Ostream& os, const String& text) {
+        const long long t0 = stats ? monotonicNs() : 0;
+        os << text;
+        os.flush();
+        if( stats ) stats->outputNs += monotonicNs() - t0;
+    }
+
+    void work() {
+        PhoneNumberWord::Scratch scratch;
+        MatchStats local;
+        const unsigned long long bytes0 = allocatedBytes;
+        if( stats ) scratch.stats = &local;
+        process(scratch);
+        if( stats ) {
+            std::lock_guard<std::mutex> lock(mtx);
+            stats->match.merge(local);
+            stats->lookupBytes += allocatedBytes - bytes0;
+        }
+    }
+
+    void process(PhoneNumberWord::Scratch& scratch) {
+        String num;
+        for(;;) {
+            size_t seq;
+            {
+                // the source may block (e.g. on stdin), so it is read under its
+                // own lock and finished results can still be handed over
+                std::lock_guard<std::mutex> srcLock(srcMtx);
+                {
+                    std::unique_lock<std::mutex> lock(mtx);
+                    while( !exhausted && nextSeq - emitted >= window ) {
+                        workCond.wait(lock);
                     }
+                    if( exhausted ) return;
                 }
+                bool more = source->next(num);
+                std::lock_guard<std::mutex> lock(mtx);
+                if( !more ) {
+                    exhausted = true;
+                    doneCond.notify_all();
+                    workCond.notify_all();
+                    return;
+                }
+                seq = nextSeq++;
             }
+            Stringstream ss;
+            ss << num << std::endl;
+            pnw.findWord(num, ss, scratch);
+            std::lock_guard<std::mutex> lock(mtx);
+            Result& r = results[seq % window];
+            r.text = ss.str();
+            r.ready = true;
+            if( seq == emitted ) doneCond.notify_one();
         }
     }
 
-    StringList words;
-    CharCharMap a2d; // letter 2 digit
-    StringStringListMap n2w; // number 2 word
+    const PhoneNumberWord& pnw;
+    const int nworkers;
+    const size_t window;
+    RunStats *stats;
+    NumberSource *source;
+    std::vector<Result> results;  // ring of `window` slots indexed by sequence
+    size_t nextSeq;               // sequence of the next number taken from source
+    size_t emitted;               // results written out so far
+    bool exhausted;
+    std::mutex srcMtx;            // serializes reads from source
+    std::mutex mtx;               // guards everything else
+    std::condition_variable workCond, doneCond;
 };
 
 
@@ -295,21 +518,71 @@ void print_usage()
     printf("Usage: %s [OPTIONS] [numbers]\n", program);
     printf("Find words hidden inside phone numbers (separated by comma).\n\n");
     printf("  If nubmers are read via stdin, two consecutive empty lines terminate input.\n");
+    printf(" --stream        Process stdin numbers (separated by newline or comma) as they arrive\n");
     printf(" -d <dictionary> File to use as dictionary (Default: /usr/share/dict/words)\n");
+    printf(" -i <index>      Use a precompiled index instead of the dictionary\n");
+    printf(" --build-index <index> Compile the dictionary into an index file and exit\n");
+    printf(" --serve <socket> Run as a server answering numbers (one per line) on a Unix socket.\n");
+    printf("                 Each worker (-j) serves one client connection at a time\n");
+    printf(" -j <threads>    Number of worker threads (Default: 1, number of cores with --serve)\n");
+    printf("                 and for loading the dictionary (Default: number of cores)\n");
     printf(" -w mininum word length (Default: 2)\n");
+    printf(" -n <max>        Print at most <max> combinations per number (Default: all)\n");
+    printf(" -k <N>          Print only the N best combinations, scored by word length squared\n");
+    printf(" -f <weights>    Word weights for -k, lines of \"word weight\" (Default: 1)\n");
+    printf(" --count         Print the number of combinations instead of the combinations\n");
+    printf(" --stats         Print timings, counters and memory use to stderr at the end\n");
     printf("\nExample:\n");
     printf(" %s 2255.63,7292650782\n", program);
+    printf(" %s --build-index words.idx && %s -i words.idx 2255.63\n", program, program);
 
 }
 
 int run(int argc, const char* argv[])
 {
     const char *dictname=NULL;
+    const char *indexname=NULL;
+    const char *buildIndexName=NULL;
+    const char *socketPath=NULL;
+    int nthreads = 0;
+    bool streaming = false;
+    int maxResults = 0;
+    int topResults = 0;
+    const char *weightsname=NULL;
+    bool countOnly = false;
+    bool showStats = false;
     String number;
     for(int i=1; i<argc; ++i) {
         if( 0 == strcmp(argv[i], "-d") ) {
             ++i;
             dictname = argv[i];
+        }else if( 0 == strcmp(argv[i], "-i") ) {
+            ++i;
+            indexname = argv[i];
+        }else if( 0 == strcmp(argv[i], "--build-index") ) {
+            ++i;
+            buildIndexName = argv[i];
+        }else if( 0 == strcmp(argv[i], "--serve") ) {
+            ++i;
+            socketPath = argv[i];
+        }else if( 0 == strcmp(argv[i], "-n") ) {
+            ++i;
+            maxResults = atoi(argv[i]);
+        }else if( 0 == strcmp(argv[i], "-k") ) {
+            ++i;
+            topResults = atoi(argv[i]);
+        }else if( 0 == strcmp(argv[i], "-f") ) {
+            ++i;
+            weightsname = argv[i];
+        }else if( 0 == strcmp(argv[i], "--count") ) {
+            countOnly = true;
+        }else if( 0 == strcmp(argv[i], "--stats") ) {
+            showStats = true;
+        }else if( 0 == strcmp(argv[i], "--stream") ) {
+            streaming = true;
+        }else if( 0 == strcmp(argv[i], "-j") ) {
+            ++i;
+            nthreads = atoi(argv[i]);
         }else if( 0 == strcmp(argv[i], "-h")
                   || 0 == strcmp(argv[i], "-?")
                   || 0 == strcmp(argv[i], "--help")) {
@@ -319,7 +592,7 @@ int run(int argc, const char* argv[])
             number = argv[i];
         }
     }
-    if( number.empty() ) {
+    if( number.empty() && !streaming && buildIndexName == NULL && socketPath == NULL ) {
         String prev="a";
         String s;
         while (getline( std::cin, s ) && (!s.empty() || !prev.empty()) ) { // exit reading on two consecutive empty lines.
@@ -329,36 +602,66 @@ int run(int argc, const char* argv[])
     }
 
     jz::PhoneNumberWord pnw;
+    pnw.setMaxResults(maxResults > 0 ? maxResults : 0);
+    pnw.setTopResults(topResults > 0 ? topResults : 0);
+    pnw.setCountOnly(countOnly);
+    pnw.setLoadThreads(nthreads);
+    pnw.setAllocationCounter(threadAllocatedBytes);
     long long time0, time1, time2;
 #ifdef TIME_IT
     time0 = current_timestamp();
 #endif
-    bool ok = dictname == NULL ? pnw.loadDict(): pnw.loadDict(dictname);
-    if( !ok ) {
-        printf("Failed to read dict file!\n");
-        return -1;
+    RunStats stats;
+    const unsigned long long bytes0 = allocatedBytes;
+    if( indexname != NULL ) {
+        if( !pnw.loadIndex(indexname) ) {
+            printf("Failed to read index file!\n");
+            return -1;
+        }
+    }else{
+        bool ok = dictname == NULL ? pnw.loadDict(): pnw.loadDict(dictname);
+        if( !ok ) {
+            printf("Failed to read dict file!\n");
+            return -1;
+        }
     }
+    stats.load = pnw.loadStats;
+    stats.loadBytes = allocatedBytes - bytes0 + pnw.loadStats.threadBytes;
 #ifdef TIME_IT
     time1 = current_timestamp();
     printf("dict loading time: %lld\n", time1-time0);
 #endif
-
-   const char DEL = ',';
-   for(int currPos = 0; currPos<number.length(); ++currPos) {
-        int pos = number.find_first_of(DEL, currPos);
-        if( pos == String::npos ) {
-            pos =  number.length();
+    if( weightsname != NULL && !pnw.loadWeights(weightsname) ) {
+        printf("Failed to read weights file!\n");
+        return -1;
+    }
+    if( buildIndexName != NULL ) {
+        if( !pnw.saveIndex(buildIndexName) ) {
+            printf("Failed to write index file!\n");
+            return -1;
         }
-        String num(number, currPos, pos-currPos);
-        Cout << num << std::endl;
-        pnw.findWord(num, Cout);
+        return 0;
+    }
+    if( socketPath != NULL ) {
+        PhoneWordServer server(pnw, nthreads > 0 ? nthreads : std::thread::hardware_concurrency());
+        return server.serve(socketPath);
+    }
 
-        currPos = pos;
+    BatchRunner runner(pnw, nthreads, showStats ? &stats : NULL);
+    if( streaming && number.empty() ) {
+        StreamNumberSource numbers(std::cin);
+        runner.run(numbers, Cout);
+    }else{
+        ListNumberSource numbers(number);
+        runner.run(numbers, Cout);
     }
 #ifdef TIME_IT
    time2 = current_timestamp();
    printf("process loading time: %lld\n", time2-time1);
 #endif
+    if( showStats ) {
+        stats.print(stderr, pnw.index);
+    }
     return 0;
 }
 